@@ -0,0 +1,81 @@
+#ifndef __FLASH_LAYOUT_H__
+#define __FLASH_LAYOUT_H__
+
+// The flash layout, in one place. Everything else is derived from it:
+// the per slot linker scripts (ld/rom.ld.in), the Makefile flash offsets,
+// rboot's default config and the OTA code's slot table. Move or resize
+// slots here and nowhere else, the checks below catch layouts which can't
+// work, and ld/rom.ld.in has the linker check where the code really ended
+// up. Addresses are flash offsets.
+
+// rboot in sector 0, its config in sector 1. Two slots, more would need
+// their own checks and table entries below and in rboot's default config.
+#define LAYOUT_ROM_COUNT    2
+
+#define LAYOUT_ROM0_ADDR    0x002000
+#define LAYOUT_ROM0_SIZE    0x07e000
+
+#define LAYOUT_ROM1_ADDR    0x082000
+#define LAYOUT_ROM1_SIZE    0x079000
+
+#define LAYOUT_SPIFFS_START 0x100000
+#define LAYOUT_SPIFFS_END   0x3fb000
+
+// flash is mapped for code at LAYOUT_FLASH_MAP, one 1MB window at a time,
+// and the esptool2 -boot2 header sits in front of .irom0.text
+#define LAYOUT_FLASH_MAP    0x40200000
+#define LAYOUT_MAP_WINDOW   0x100000
+#define LAYOUT_IROM_OFFSET  0x10
+
+#define LAYOUT_IROM_ORG(addr)   (LAYOUT_FLASH_MAP + ((addr) % LAYOUT_MAP_WINDOW) + LAYOUT_IROM_OFFSET)
+#define LAYOUT_IROM_LEN(size)   ((size) - LAYOUT_IROM_OFFSET)
+
+// LAYOUT_ROM_ADDR(0) is LAYOUT_ROM0_ADDR, also when n is itself a macro
+#define LAYOUT_CAT(a, b, c)     a ## b ## c
+#define LAYOUT_XCAT(a, b, c)    LAYOUT_CAT(a, b, c)
+#define LAYOUT_ROM_ADDR(n)      LAYOUT_XCAT(LAYOUT_ROM, n, _ADDR)
+#define LAYOUT_ROM_SIZE(n)      LAYOUT_XCAT(LAYOUT_ROM, n, _SIZE)
+
+#define LAYOUT_ROM_END(n)       (LAYOUT_ROM_ADDR(n) + LAYOUT_ROM_SIZE(n))
+
+// largest rom any slot can take
+#define LAYOUT_MAX_ROM_SIZE \
+	(LAYOUT_ROM0_SIZE > LAYOUT_ROM1_SIZE ? LAYOUT_ROM0_SIZE : LAYOUT_ROM1_SIZE)
+
+#ifndef LAYOUT_LINKER_SCRIPT
+
+#ifdef __cplusplus
+#define LAYOUT_ASSERT(cond, msg) static_assert(cond, msg)
+#else
+#define LAYOUT_ASSERT(cond, msg) _Static_assert(cond, msg)
+#endif
+
+#define LAYOUT_CHECK_ROM(n) \
+	LAYOUT_ASSERT(LAYOUT_ROM_ADDR(n) % 0x1000 == 0, "rom " #n " is not sector aligned"); \
+	LAYOUT_ASSERT(LAYOUT_ROM_SIZE(n) % 0x1000 == 0, "rom " #n " size is not whole sectors"); \
+	LAYOUT_ASSERT(LAYOUT_ROM_ADDR(n) >= 0x2000, "rom " #n " overlaps rboot or its config"); \
+	LAYOUT_ASSERT(LAYOUT_ROM_ADDR(n) / LAYOUT_MAP_WINDOW == (LAYOUT_ROM_END(n) - 1) / LAYOUT_MAP_WINDOW, \
+		"rom " #n " straddles a 1MB mapping window"); \
+	LAYOUT_ASSERT(LAYOUT_ROM_END(n) <= LAYOUT_SPIFFS_START || LAYOUT_ROM_ADDR(n) >= LAYOUT_SPIFFS_END, \
+		"rom " #n " overlaps spiffs")
+
+LAYOUT_ASSERT(LAYOUT_ROM_COUNT == 2, "the layout checks and tables are written for two roms");
+LAYOUT_CHECK_ROM(0);
+LAYOUT_CHECK_ROM(1);
+LAYOUT_ASSERT(LAYOUT_ROM0_ADDR + LAYOUT_ROM0_SIZE <= LAYOUT_ROM1_ADDR, "rom 0 overlaps rom 1");
+
+#ifndef BOOT_BIG_FLASH
+// without big flash support only the first window is ever mapped
+LAYOUT_ASSERT(LAYOUT_ROM_END(1) <= LAYOUT_MAP_WINDOW, "rom 1 is beyond the first 1MB, needs BOOT_BIG_FLASH");
+#endif
+
+#ifdef __cplusplus
+#include <stdint.h>
+
+static constexpr uint32_t layout_rom_addr[LAYOUT_ROM_COUNT] = { LAYOUT_ROM0_ADDR, LAYOUT_ROM1_ADDR };
+static constexpr uint32_t layout_rom_size[LAYOUT_ROM_COUNT] = { LAYOUT_ROM0_SIZE, LAYOUT_ROM1_SIZE };
+#endif
+
+#endif // LAYOUT_LINKER_SCRIPT
+
+#endif
@@ -0,0 +1,272 @@
+//Add proper header
+
+#include <Arduino.h>
+#include <IPAddress.h>
+#include <ESP8266WiFi.h>
+
+#include "rBootOTA.h"
+#include "rBootOTA-private.h"
+#include "flash_utils.h"
+
+extern "C" {
+  #include "c_types.h"
+  #include "osapi.h"
+}
+
+// longest ETag or Last-Modified value we remember
+#define OTA_VALIDATOR_SIZE  64
+
+// ETag or Last-Modified of the last manifest we acted on, empty until then
+static char validator[OTA_VALIDATOR_SIZE + 1];
+
+// longest version we remember
+#define OTA_VERSION_SIZE    40
+
+// version of the last update tried. A successful one reboots, so if it's
+// still set here it failed, and isn't fetched again until the manifest
+// names another version. Cleared by a reboot.
+static char tried_version[OTA_VERSION_SIZE + 1];
+
+// longest rom url in the manifest
+#define OTA_ROM_PATH_SIZE   96
+
+// value of key in the manifest body, "key=value" lines, or NULL
+static const char* manifest_value(const char* body, const char* key) {
+    size_t key_len = os_strlen(key);
+    const char* line = body;
+    while (line && *line) {
+        if (os_strncmp(line, key, key_len) == 0 && line[key_len] == '=') {
+            return line + key_len + 1;
+        }
+        line = os_strstr(line, "\n");
+        if (line) line++;
+    }
+    return NULL;
+}
+
+// length of a manifest value, up to the end of its line
+static size_t value_len(const char* value) {
+    size_t len = 0;
+    while (value[len] && value[len] != '\r' && value[len] != '\n') {
+        len++;
+    }
+    return len;
+}
+
+// whether a manifest value is exactly str
+static bool value_is(const char* value, const char* str) {
+    size_t len = value_len(value);
+    return len == os_strlen(str) && os_strncmp(value, str, len) == 0;
+}
+
+// the conditional request header for a validator from ota_http_validator(),
+// ETags are quoted, Last-Modified dates aren't (python's http.server only
+// does Last-Modified)
+static void validator_header(const char* value, char* out, size_t size) {
+    out[0] = 0;
+    if (value[0] == 0) {
+        return;
+    }
+    bool etag = value[0] == '"' || os_strncmp(value, "W/", 2) == 0;
+    snprintf(out, size, "%s: %s\r\n", etag ? "If-None-Match" : "If-Modified-Since", value);
+}
+
+// fetch path into the slot at addr, it has to be exactly size bytes
+static bool download_rom(IPAddress ip, uint16_t port, const char* path,
+        uint32_t addr, uint32_t size, uint8_t* buf) {
+    WiFiClient conn;
+    bool ok = false;
+
+    int status = ota_http_get(conn, ip, port, (char*)buf, OTA_BUF_SIZE, "", "%s", path);
+    if (status != 200) {
+        DEBUG("OTA_check_update: bad HTTP status %d", status);
+        goto done;
+    }
+
+    {   // because goto
+    const char* clen_pos = ota_http_header((const char*)buf, "Content-Length:");
+    if (clen_pos == NULL || (uint32_t)atoi(clen_pos) != size) {
+        DEBUG("OTA_check_update: rom size does not match the manifest");
+        goto done;
+    }
+
+    if (!ota_erase(addr, size)) {
+        goto done;
+    }
+
+    ok = ota_copy_body(conn, addr, size, buf) == OTA_COPY_DONE;
+    }
+
+    done:
+    conn.stop();
+    return ok;
+}
+
+/**
+ * Poll a manifest and update if it names another version
+ *
+ * The manifest is small and fetched conditionally, so polling a server
+ * that still has the same build costs one round trip and a 304. Only when
+ * the version differs is the rom for the upgrade slot downloaded, checked
+ * against the size and crc32 from the manifest, and booted. If that fails
+ * the same version isn't tried again until the manifest names another one.
+ */
+
+int OTA_check_update(IPAddress ip, uint16_t port, const char * manifest_url,
+        const char * current_version) {
+    static bool in_progress = false;
+    if (in_progress) {
+        DEBUG("OTA_check_update: already updating!");
+        return OTA_CHECK_ERROR;
+    }
+    in_progress = true;
+    DEBUG("OTA_check_update: ENTER");
+
+    WiFiClient conn;
+    char* buf = NULL;
+    char next_validator[sizeof(validator)];
+    char conditional[sizeof(validator) + 24];
+    char key[8];
+    char rom_path[OTA_ROM_PATH_SIZE];
+    const char *version, *size_pos, *crc_pos, *path;
+    uint32_t rom_size, rom_crc;
+    size_t dir_len;
+    int result = OTA_CHECK_ERROR;
+
+    rboot_config bootconf = rboot_get_config();
+    uint8_t upgrade_slot = bootconf.current_rom == 0 ? 1 : 0;
+    uint32_t slot_addr = bootconf.roms[upgrade_slot];
+
+    if (!ota_check_slot(upgrade_slot, slot_addr)) {
+        goto bail;
+    }
+
+    buf = (char*)ota_alloc(OTA_BUF_SIZE);
+    if (!buf) {
+        DEBUG("OTA_check_update: buffer allocation failed");
+        goto bail;
+    }
+
+    {   // because goto
+    validator_header(validator, conditional, sizeof(conditional));
+    int status = ota_http_get(conn, ip, port, buf, OTA_BUF_SIZE, conditional, "%s", manifest_url);
+    if (status == 304) {
+        DEBUG("OTA_check_update: manifest not modified");
+        result = OTA_CHECK_NO_UPDATE;
+        goto bail;
+    }
+    if (status != 200) {
+        DEBUG("OTA_check_update: bad HTTP status %d", status);
+        goto bail;
+    }
+    ota_http_validator(buf, next_validator, sizeof(next_validator));
+
+    // the manifest replaces the headers in buf
+    uint32_t start = millis();
+    size_t len = 0;
+    while (len < OTA_BUF_SIZE - 1 && (conn.connected() || conn.available())) {
+        if (conn.available()) {
+            len += conn.read((uint8_t*)buf + len, OTA_BUF_SIZE - 1 - len);
+            continue;
+        }
+        if ((millis() - start) > 3000) {
+            DEBUG("OTA_check_update: manifest read timeout");
+            goto bail;
+        }
+        yield();
+    }
+    buf[len] = 0;
+    conn.stop();
+
+    version = manifest_value(buf, "version");
+    if (version == NULL) {
+        DEBUG("OTA_check_update: no version in manifest");
+        goto bail;
+    }
+    // either way the next poll is conditional on this manifest, so a
+    // failed update isn't downloaded again until the manifest changes
+    os_memcpy(validator, next_validator, sizeof(validator));
+    if (value_is(version, current_version)) {
+        DEBUG("OTA_check_update: already running %s", current_version);
+        result = OTA_CHECK_NO_UPDATE;
+        goto bail;
+    }
+    // servers without a validator send the whole manifest every time
+    if (tried_version[0] && value_is(version, tried_version)) {
+        DEBUG("OTA_check_update: %s failed before, not trying again", tried_version);
+        result = OTA_CHECK_NO_UPDATE;
+        goto bail;
+    }
+    if (value_len(version) < sizeof(tried_version)) {
+        os_memcpy(tried_version, version, value_len(version));
+        tried_version[value_len(version)] = 0;
+    }
+
+    snprintf(key, sizeof(key), "size%d", upgrade_slot);
+    size_pos = manifest_value(buf, key);
+    snprintf(key, sizeof(key), "crc%d", upgrade_slot);
+    crc_pos = manifest_value(buf, key);
+    snprintf(key, sizeof(key), "url%d", upgrade_slot);
+    path = manifest_value(buf, key);
+    if (size_pos == NULL || crc_pos == NULL || path == NULL || value_len(path) == 0) {
+        DEBUG("OTA_check_update: no rom %d in manifest", upgrade_slot);
+        goto bail;
+    }
+    rom_size = atoi(size_pos);
+    rom_crc = strtoul(crc_pos, NULL, 16);
+    if (!ota_check_size(upgrade_slot, rom_size)) {
+        DEBUG("OTA_check_update: bad rom size: %d", rom_size);
+        goto bail;
+    }
+
+    // the request clobbers buf, so the path is copied out. A relative url
+    // is relative to the manifest's directory.
+    if (path[0] == '/') {
+        dir_len = 0;
+    } else if (const char* slash = strrchr(manifest_url, '/')) {
+        dir_len = slash + 1 - manifest_url;
+    } else {
+        manifest_url = "/";
+        dir_len = 1;
+    }
+    if (dir_len + value_len(path) >= sizeof(rom_path)) {
+        DEBUG("OTA_check_update: rom url too long");
+        goto bail;
+    }
+    os_memcpy(rom_path, manifest_url, dir_len);
+    os_memcpy(rom_path + dir_len, path, value_len(path));
+    rom_path[dir_len + value_len(path)] = 0;
+    }
+
+    DEBUG("OTA_check_update: new version, downloading %s", rom_path);
+    if (!download_rom(ip, port, rom_path, slot_addr, rom_size, (uint8_t*)buf)) {
+        goto bail;
+    }
+
+    if (ota_flash_crc32(slot_addr, rom_size, (uint8_t*)buf, OTA_BUF_SIZE) != rom_crc) {
+        DEBUG("OTA_check_update: image crc mismatch");
+        goto bail;
+    }
+    if (!ota_check_image(slot_addr)) {
+        DEBUG("OTA_check_update: image checksum mismatch");
+        goto bail;
+    }
+
+    // release the buffer first, so the config commit fits the arena
+    ota_free(buf);
+    buf = NULL;
+
+    // update current rom slot and reboot
+    if (ota_boot_rom(upgrade_slot)) {
+        return OTA_CHECK_NO_UPDATE;
+    }
+
+    bail:
+    if (result != OTA_CHECK_NO_UPDATE) {
+        DEBUG("OTA_check_update failed!");
+    }
+    in_progress = false;
+    if (buf) ota_free(buf);
+    if (conn && conn.connected()) conn.stop();
+    return result;
+}
@@ -0,0 +1,271 @@
+//Add proper header
+
+#include <Arduino.h>
+#include <IPAddress.h>
+#include <ESP8266WiFi.h>
+#include <WiFiUdp.h>
+
+#include "rBootOTA.h"
+#include "rBootOTA-private.h"
+#include "rBootMcastOTA.h"
+#include "flash_utils.h"
+
+extern "C" {
+  #include "c_types.h"
+  #include "osapi.h"
+}
+
+static_assert(sizeof(mcast_ota_header) + 2 * MCAST_MAX_BLOCK_SIZE <= RBOOT_OTA_ARENA_SIZE,
+        "multicast buffers do not fit the arena");
+
+// resend the list of missing blocks this often once the sender is done
+#define MCAST_NAK_INTERVAL      500
+
+#define MCAST_MAX_BLOCKS        (OTA_MAX_ROM_SIZE / MCAST_MIN_BLOCK_SIZE)
+
+// one bit per block of the image being received
+static uint8_t mcast_bitmap[(MCAST_MAX_BLOCKS + 7) / 8];
+
+#define BLOCK_HAVE(i)   (mcast_bitmap[(i) >> 3] & (1 << ((i) & 7)))
+#define BLOCK_SET(i)    (mcast_bitmap[(i) >> 3] |= (1 << ((i) & 7)))
+
+struct mcast_session {
+    bool     active;        // the sender may use any id, 0 included
+    uint32_t id;
+    uint32_t image_size;
+    uint32_t image_crc;
+    uint16_t block_size;
+    uint8_t  group_size;
+    uint16_t blocks;
+    uint16_t received;
+    uint32_t slot_addr;
+};
+
+static uint32_t block_len(const mcast_session* s, uint16_t index) {
+    uint32_t offset = (uint32_t)index * s->block_size;
+    uint32_t left = s->image_size - offset;
+    return left < s->block_size ? left : s->block_size;
+}
+
+// set up a session from the first packet seen for it and erase the slot
+static bool session_start(mcast_session* s, const mcast_ota_header* hdr, uint32_t slot_addr) {
+    if (!ota_check_size(hdr->slot, hdr->image_size)) {
+        DEBUG("OTA_multicast: bad rom size: %d", hdr->image_size);
+        return false;
+    }
+    if (hdr->block_size < MCAST_MIN_BLOCK_SIZE || hdr->block_size > MCAST_MAX_BLOCK_SIZE
+            || hdr->block_size % 4 || hdr->group_size == 0) {
+        DEBUG("OTA_multicast: bad block size: %d/%d", hdr->block_size, hdr->group_size);
+        return false;
+    }
+
+    s->active = false;
+    s->id = hdr->session;
+    s->image_size = hdr->image_size;
+    s->image_crc = hdr->image_crc;
+    s->block_size = hdr->block_size;
+    s->group_size = hdr->group_size;
+    s->blocks = (hdr->image_size + hdr->block_size - 1) / hdr->block_size;
+    s->received = 0;
+    s->slot_addr = slot_addr;
+    os_memset(mcast_bitmap, 0, sizeof(mcast_bitmap));
+
+    DEBUG("OTA_multicast: session 0x%08x, %d blocks", s->id, s->blocks);
+    if (!ota_erase(slot_addr, s->image_size)) {
+        return false;
+    }
+    s->active = true;
+    return true;
+}
+
+static bool session_matches(const mcast_session* s, const mcast_ota_header* hdr) {
+    return hdr->image_size == s->image_size && hdr->image_crc == s->image_crc
+        && hdr->block_size == s->block_size && hdr->group_size == s->group_size;
+}
+
+static bool store_block(mcast_session* s, uint16_t index, uint8_t* data) {
+    if (SPIWrite(s->slot_addr + (uint32_t)index * s->block_size, data, block_len(s, index))) {
+        DEBUG("flash write failed for block %d", index);
+        return false;
+    }
+    BLOCK_SET(index);
+    s->received++;
+    return true;
+}
+
+// rebuild the single missing block of a group from its parity, the blocks
+// we do have are read back from flash into scratch
+static bool recover_block(mcast_session* s, uint16_t group, uint8_t* parity, uint8_t* scratch) {
+    uint16_t first = group * s->group_size;
+    if (first >= s->blocks) return true;
+    uint16_t last = first + s->group_size;
+    if (last > s->blocks) last = s->blocks;
+
+    int missing = -1;
+    for (uint16_t i = first; i < last; i++) {
+        if (BLOCK_HAVE(i)) continue;
+        if (missing >= 0) return true;  // two or more lost, leave it to NAK
+        missing = i;
+    }
+    if (missing < 0) return true;
+
+    for (uint16_t i = first; i < last; i++) {
+        if (i == missing) continue;
+        uint32_t len = block_len(s, i);
+        SPIRead(s->slot_addr + (uint32_t)i * s->block_size, scratch, len);
+        for (uint32_t j = 0; j < len; j++) {
+            parity[j] ^= scratch[j];
+        }
+    }
+    DEBUG("OTA_multicast: recovered block %d", missing);
+    return store_block(s, missing, parity);
+}
+
+static void send_nak(WiFiUDP& udp, IPAddress ip, uint16_t port,
+        const mcast_session* s, uint8_t slot, uint8_t* buf) {
+    mcast_ota_header* hdr = (mcast_ota_header*)buf;
+    uint16_t* list = (uint16_t*)(buf + sizeof(mcast_ota_header));
+
+    os_memset(hdr, 0, sizeof(mcast_ota_header));
+    hdr->magic = MCAST_OTA_MAGIC;
+    hdr->type = MCAST_NAK;
+    hdr->slot = slot;
+    hdr->session = s->id;
+    for (uint16_t i = 0; i < s->blocks && hdr->count < MCAST_MAX_NAK; i++) {
+        if (!BLOCK_HAVE(i)) list[hdr->count++] = i;
+    }
+    DEBUG("OTA_multicast: NAK %d blocks", hdr->count);
+
+    udp.beginPacket(ip, port);
+    udp.write(buf, sizeof(mcast_ota_header) + hdr->count * sizeof(uint16_t));
+    udp.endPacket();
+}
+
+/**
+ * Perform an OTA update from a multicast sender
+ *
+ * See tools/ota_mcast_send.py for the other end. If successful -- update
+ * the rboot config and reboot.
+ */
+
+void OTA_multicast_update(IPAddress group, uint16_t port, uint32_t timeout_ms) {
+    static bool in_progress = false;
+    if (in_progress) {
+        DEBUG("OTA_multicast: already updating!");
+        return;
+    }
+    in_progress = true;
+    DEBUG("OTA_multicast: ENTER");
+
+    WiFiUDP udp;
+    mcast_session session;
+    os_memset(&session, 0, sizeof(session));
+    mcast_ota_header* hdr;
+    uint8_t* payload;
+    uint8_t* scratch = NULL;
+    IPAddress sender_ip;
+    uint16_t sender_port = 0;
+    uint32_t start, last_nak = 0;
+    bool end_seen = false;
+
+    rboot_config bootconf = rboot_get_config();
+    uint8_t upgrade_slot = bootconf.current_rom == 0 ? 1 : 0;
+    uint32_t slot_addr = bootconf.roms[upgrade_slot];
+
+    uint8_t* buf = (uint8_t*)ota_alloc(sizeof(mcast_ota_header) + MCAST_MAX_BLOCK_SIZE);
+    if (!buf) {
+        DEBUG("OTA_multicast: buffer allocation failed");
+        goto bail;
+    }
+    scratch = (uint8_t*)ota_alloc(MCAST_MAX_BLOCK_SIZE);
+    if (!scratch) {
+        DEBUG("OTA_multicast: buffer allocation failed");
+        goto bail;
+    }
+    hdr = (mcast_ota_header*)buf;
+    payload = buf + sizeof(mcast_ota_header);
+
+    if (!ota_check_slot(upgrade_slot, slot_addr)) {
+        goto bail;
+    }
+
+    if (!udp.beginMulticast(WiFi.localIP(), group, port)) {
+        DEBUG("OTA_multicast: joining group failed");
+        goto bail;
+    }
+    DEBUG(("OTA_multicast: listening on " IPSTR ":%d for rom %d"),
+            IP2STR((uint32_t)group), port, upgrade_slot);
+
+    start = millis();
+    while (!session.active || session.received < session.blocks) {
+        yield();
+
+        if ((millis() - start) > timeout_ms) {
+            DEBUG("OTA_multicast: timeout, have %d of %d blocks", session.received, session.blocks);
+            goto bail;
+        }
+
+        if (end_seen && (millis() - last_nak) > MCAST_NAK_INTERVAL) {
+            send_nak(udp, sender_ip, sender_port, &session, upgrade_slot, scratch);
+            last_nak = millis();
+        }
+
+        int len = udp.parsePacket();
+        if (len <= 0) continue;
+        len = udp.read(buf, sizeof(mcast_ota_header) + MCAST_MAX_BLOCK_SIZE);
+        if (len < (int)sizeof(mcast_ota_header) || hdr->magic != MCAST_OTA_MAGIC) continue;
+        if (hdr->slot != upgrade_slot || hdr->type == MCAST_NAK) continue;
+
+        if (!session.active || hdr->session != session.id || !session_matches(&session, hdr)) {
+            // first packet, or the sender moved on to newer images
+            end_seen = false;
+            if (!session_start(&session, hdr, slot_addr)) continue;
+        }
+
+        switch (hdr->type) {
+        case MCAST_DATA:
+            if (hdr->index >= session.blocks || BLOCK_HAVE(hdr->index)) break;
+            if (len - sizeof(mcast_ota_header) != block_len(&session, hdr->index)) break;
+            if (!store_block(&session, hdr->index, payload)) goto bail;
+            break;
+        case MCAST_PARITY:
+            if (len - sizeof(mcast_ota_header) != session.block_size) break;
+            if (!recover_block(&session, hdr->index, payload, scratch)) goto bail;
+            break;
+        case MCAST_END:
+            end_seen = true;
+            sender_ip = udp.remoteIP();
+            sender_port = udp.remotePort();
+            break;
+        }
+    }
+    udp.stop();
+
+    DEBUG("OTA_multicast: all %d blocks received, verifying", session.blocks);
+    if (ota_flash_crc32(slot_addr, session.image_size, scratch, MCAST_MAX_BLOCK_SIZE) != session.image_crc) {
+        DEBUG("OTA_multicast: image crc mismatch");
+        goto bail;
+    }
+    if (!ota_check_image(slot_addr)) {
+        DEBUG("OTA_multicast: image checksum mismatch");
+        goto bail;
+    }
+
+    // release the buffers first, so the config commit fits the arena
+    ota_free(scratch);
+    ota_free(buf);
+    scratch = buf = NULL;
+
+    // update current rom slot and reboot
+    if (ota_boot_rom(upgrade_slot)) {
+        return;
+    }
+
+    bail:
+    DEBUG("OTA_multicast failed!");
+    in_progress = false;
+    udp.stop();
+    if (scratch) ota_free(scratch);
+    if (buf) ota_free(buf);
+    return;
+}
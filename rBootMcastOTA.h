@@ -0,0 +1,50 @@
+//Add proper header
+
+#ifndef _RBOOT_MCAST_OTA_H
+#define _RBOOT_MCAST_OTA_H
+
+#include "Arduino.h"
+#include "IPAddress.h"
+
+// Wire format shared with tools/ota_mcast_send.py, all fields little endian.
+//
+// The sender multicasts both rom images (each linked for its own slot) as
+// numbered blocks, followed after every group_size blocks by a parity block
+// which is the XOR of the group. A receiver takes only the image for its
+// upgrade slot, writes blocks to flash in whatever order they arrive and can
+// rebuild one lost block per group from the parity. Anything still missing
+// after MCAST_END is asked for with a unicast MCAST_NAK to the sender.
+
+#define MCAST_OTA_MAGIC         0x434d4272  // "rBMC"
+
+#define MCAST_DATA              0x01    // index is the block number
+#define MCAST_PARITY            0x02    // index is the group number
+#define MCAST_END               0x03    // sender finished a round
+#define MCAST_NAK               0x04    // receiver -> sender, list of blocks
+
+#define MCAST_MIN_BLOCK_SIZE    512
+#define MCAST_MAX_BLOCK_SIZE    1024
+#define MCAST_MAX_NAK           64      // block numbers per MCAST_NAK
+
+typedef struct {
+    uint32_t magic;
+    uint8_t  type;
+    uint8_t  slot;          // rom slot the image is linked for
+    uint16_t index;
+    uint32_t session;       // changes with every new pair of images
+    uint32_t image_size;    // bytes, multiple of 4
+    uint32_t image_crc;     // crc32 of the whole image
+    uint16_t block_size;    // bytes, multiple of 4
+    uint8_t  group_size;    // data blocks per parity block
+    uint8_t  count;         // MCAST_NAK only: number of uint16 block numbers
+} __attribute__((packed)) mcast_ota_header;
+
+/**
+ * Join a multicast group and receive the image for the upgrade slot.
+ *
+ * Gives up after timeout_ms without a complete image. On success the image
+ * is verified, the rboot config updated and the device rebooted.
+ */
+void OTA_multicast_update(IPAddress group, uint16_t port, uint32_t timeout_ms);
+
+#endif //_RBOOT_MCAST_OTA_H
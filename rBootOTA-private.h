@@ -0,0 +1,124 @@
+//Add proper header
+
+#ifndef _RBOOT_OTA_PRIVATE_H
+#define _RBOOT_OTA_PRIVATE_H
+
+// Internal helpers shared by the OTA implementations, not part of the
+// public API in rBootOTA.h.
+
+#include "rBootOTA.h"
+#include "flash_layout.h"
+#include <ESP8266WiFi.h>
+
+#define DEBUG(...)
+//#define DEBUG(fmt, ...)		os_printf(fmt "\r\n", ##__VA_ARGS__)
+
+#define OTA_BUF_SIZE     1536
+
+static_assert(SECTOR_SIZE + OTA_BUF_SIZE <= RBOOT_OTA_ARENA_SIZE,
+        "staging checkpoints do not fit the arena");
+
+// largest image that fits any of the rom slots
+#define OTA_MAX_ROM_SIZE LAYOUT_MAX_ROM_SIZE
+
+// buffers for the update and config paths, from the arena if one is set,
+// see OTA_set_arena(). ota_free() releases ptr and anything allocated from
+// the arena after it, so free in reverse order of allocation.
+void* ota_alloc(size_t size);
+void ota_free(void* ptr);
+
+// connect, send a GET for the printf style path with the extra request
+// headers (each ending in \r\n) and read the response headers into buf,
+// NUL terminated. Returns the HTTP status code, or -1 on failure.
+int ota_http_get(WiFiClient& conn, IPAddress ip, uint16_t port, char* buf, size_t size,
+        const char* extra, const char* path_fmt, ...);
+
+// read a header block, up to and including the blank line, into buf and
+// NUL terminate it. Returns its length or -1.
+int ota_http_read_headers(WiFiClient& conn, char* buf, size_t size);
+
+// value of the header name (including the colon) or NULL
+const char* ota_http_header(const char* headers, const char* name);
+
+// ETag of the response, or its Last-Modified if there's no ETag, copied
+// to out. ETags are quoted, so the two can be told apart. Returns false,
+// with out empty, if there's neither or it doesn't fit.
+bool ota_http_validator(const char* headers, char* out, size_t size);
+
+// total length from "Content-Range: bytes 0-0/123456", or -1
+int ota_http_range_total(const char* headers);
+
+// first and last byte from "Content-Range: bytes 4096-8191/123456",
+// false if there's no such header
+bool ota_http_range(const char* headers, uint32_t* first, uint32_t* last);
+
+// read or replace part of the boot config sector, offset and len must be
+// multiples of 4. Writing preserves the rest of the sector, the rboot
+// config lives at offset 0.
+void ota_config_sector_read(uint32_t offset, void* data, size_t len);
+bool ota_config_sector_write(uint32_t offset, const void* data, size_t len);
+
+// Erase commands ota_erase() may use, each a power of two. A 64K block
+// erase takes about as long as two or three 4K sector erases on the usual
+// SPI NOR parts, so aligned stretches go by the block. Flash chips have a
+// 32K erase too, but neither the ROM nor the SDK has a call for it, add
+// 0x8000 here along with a case in ota_erase() and the check below once
+// there is one.
+#define OTA_ERASE_BLOCK_SIZE    0x10000
+#define OTA_ERASE_SIZES         (OTA_ERASE_BLOCK_SIZE | SECTOR_SIZE)
+
+static_assert((OTA_ERASE_SIZES & ~(OTA_ERASE_BLOCK_SIZE | SECTOR_SIZE)) == 0,
+        "OTA_ERASE_SIZES has an erase size ota_erase() cannot issue");
+
+// largest erase in OTA_ERASE_SIZES that starts at the sector aligned addr
+// and ends at or before end. Erasing from addr to end in steps of this
+// takes the fewest commands: sectors up to the first aligned block, then
+// blocks, then sectors again for the tail.
+uint32_t ota_erase_size(uint32_t addr, uint32_t end);
+
+// erase the sectors covering len bytes from the sector aligned addr
+bool ota_erase(uint32_t addr, uint32_t len);
+
+// move whatever the connection has buffered, up to max_len bytes and
+// rounded down to 4, into flash at addr. Returns the number of bytes
+// written, which may be 0, or -1 on failure.
+int32_t ota_copy_to_flash(WiFiClient& conn, uint32_t addr, uint32_t max_len, uint8_t* buf);
+
+// an update will timeout eventually
+#define OTA_BODY_TIMEOUT    60000
+
+#define OTA_COPY_DONE       0
+#define OTA_COPY_FAILED     -1  // read or flash write failed
+#define OTA_COPY_CLOSED     -2  // connection died early
+#define OTA_COPY_TIMEOUT    -3
+
+// copy len bytes of response or request body from conn into flash at addr
+// with ota_copy_to_flash(), buf is OTA_BUF_SIZE bytes of scratch. Gives up
+// after OTA_BODY_TIMEOUT ms. Returns one of OTA_COPY_*.
+int ota_copy_body(WiFiClient& conn, uint32_t addr, uint32_t len, uint8_t* buf);
+
+// point the rboot config at slot and reboot into it, free the update
+// buffers first so the config commit fits the arena. Returns false,
+// without rebooting, if the config could not be written.
+bool ota_boot_rom(uint8_t slot);
+
+// reboot into the rom the config already points at
+void ota_restart();
+
+// the rboot config points slot at addr, and that's where flash_layout.h,
+// which the roms are linked for, has it too
+bool ota_check_slot(uint8_t slot, uint32_t addr);
+
+// a rom of size bytes is plausible and fits slot
+bool ota_check_size(uint8_t slot, int size);
+
+// crc32 (same polynomial as zlib), pass 0 as crc to start a new one
+uint32_t ota_crc32(uint32_t crc, const uint8_t* data, size_t len);
+
+// crc32 over len bytes of flash starting at addr, buf is scratch space
+uint32_t ota_flash_crc32(uint32_t addr, uint32_t len, uint8_t* buf, size_t buf_size);
+
+// walk the rom at addr and verify the rboot image checksum
+bool ota_check_image(uint32_t addr);
+
+#endif //_RBOOT_OTA_PRIVATE_H
@@ -1,16 +1,15 @@
 //Add proper header
 
+#include <stdarg.h>
 #include <Arduino.h>
 #include <IPAddress.h>
 #include <ESP8266WiFi.h>
 
 #include "rBootOTA.h"
+#include "rBootOTA-private.h"
 #include "flash_utils.h"
 #include "debug.h"
 
-#define DEBUG(...)
-//#define DEBUG(fmt, ...)		os_printf(fmt "\r\n", ##__VA_ARGS__)
-
 extern "C" {
   #include "c_types.h"
   #include "ets_sys.h"
@@ -45,19 +44,10 @@ extern "C" {
   // of sector can be used to store user data
   // updates checksum automatically, if enabled
   bool ICACHE_FLASH_ATTR rboot_set_config(rboot_config *conf) {
-    uint8 *buffer;
   #ifdef BOOT_CONFIG_CHKSUM
     uint8 chksum;
     uint8 *ptr;
-  #endif
 
-    buffer = (uint8*)os_malloc(SECTOR_SIZE);
-    if (!buffer) {
-      DEBUG("No ram!\r\n");
-      return false;
-    }
-
-  #ifdef BOOT_CONFIG_CHKSUM
     chksum = CHKSUM_INIT;
     for (ptr = (uint8*)conf; ptr < &conf->chksum; ptr++) {
       chksum ^= *ptr;
@@ -65,23 +55,7 @@ extern "C" {
     conf->chksum = chksum;
   #endif
 
-    WDT_FEED();
-    noInterrupts();
-    spi_flash_read(BOOT_CONFIG_SECTOR * SECTOR_SIZE, (uint32*)buffer, SECTOR_SIZE);
-    interrupts();
-
-    os_memcpy(buffer, conf, sizeof(rboot_config));
-
-    noInterrupts();
-    spi_flash_erase_sector(BOOT_CONFIG_SECTOR);
-    interrupts();
-
-    noInterrupts();
-    spi_flash_write(BOOT_CONFIG_SECTOR * SECTOR_SIZE, (uint32*)buffer, SECTOR_SIZE);
-    interrupts();
-
-    os_free(buffer);
-    return true;
+    return ota_config_sector_write(0, conf, sizeof(rboot_config));
   }
 
   // get current boot rom
@@ -101,12 +75,14 @@ extern "C" {
   }
 
   void ICACHE_FLASH_ATTR rboot_dump_config(rboot_config* c) {
+    rboot_config current;
     rboot_config* conf = c;
     if(!c) {
-      conf = (rboot_config*)os_malloc(sizeof(rboot_config));
-      *conf = rboot_get_config();
+      current = rboot_get_config();
+      conf = &current;
     }
     //hexdump((uint8_t*)conf, sizeof(rboot_config));
+    (void)conf;     // only used by DEBUG
 
     DEBUG("bootconf.magic: %d", conf->magic);
     DEBUG("bootconf.version: %d", conf->version);
@@ -114,12 +90,146 @@ extern "C" {
     DEBUG("bootconf.current_rom: %d", conf->current_rom);
     DEBUG("bootconf.gpio_rom: %d", conf->gpio_rom);
     DEBUG("bootconf.count: %d", conf->count);
+  }
 
-    if(!c) {
-      os_free(conf);
+}
+
+
+/**
+ * Boot log written by rboot in quiet mode.
+ */
+
+uint8_t rboot_get_boot_log(uint32_t* records, uint8_t max) {
+    uint32_t log[2 + BOOT_LOG_RECORDS];
+    system_rtc_mem_read(BOOT_LOG_RTC_BLOCK, log, sizeof(log));
+
+    uint32_t next = (log[0] >> 8) & 0xff;
+    uint32_t count = log[0] & 0xff;
+    if ((log[0] >> 16) != BOOT_LOG_MAGIC || next >= BOOT_LOG_RECORDS || count > BOOT_LOG_RECORDS) {
+        return 0;
+    }
+
+    // oldest record first
+    uint32_t pos = (next + BOOT_LOG_RECORDS - count) % BOOT_LOG_RECORDS;
+    uint8_t n;
+    for (n = 0; n < count && n < max; n++) {
+        records[n] = log[2 + pos];
+        pos = (pos + 1) % BOOT_LOG_RECORDS;
+    }
+    return n;
+}
+
+void rboot_format_boot_log(uint32_t record, char* buf, size_t size) {
+    static const char* const sizes[] = { "4 Mbit", "2 Mbit", "8 Mbit", "16 Mbit", "32 Mbit" };
+    static const char* const modes[] = { "QIO", "QOUT", "DIO", "DOUT" };
+    uint32_t value = BOOT_LOG_VALUE(record);
+    uint8_t flags1 = value >> 8;
+    uint8_t flags2 = value & 0xff;
+    const char* speed;
+
+    switch (BOOT_LOG_TYPE(record)) {
+    case BOOT_LOG_START:
+        snprintf(buf, size, "rBoot boot #%u", value);
+        break;
+    case BOOT_LOG_FLASH:
+        switch (flags2 & 0x0f) {
+        case 0: speed = "40 MHz"; break;
+        case 1: speed = "26.7 MHz"; break;
+        case 2: speed = "20 MHz"; break;
+        case 0x0f: speed = "80 MHz"; break;
+        default: speed = "unknown"; break;
+        }
+        snprintf(buf, size, "Flash Size: %s, Mode: %s, Speed: %s",
+                (flags2 >> 4) < 5 ? sizes[flags2 >> 4] : "unknown",
+                flags1 < 4 ? modes[flags1] : "unknown", speed);
+        break;
+    case BOOT_LOG_OPTIONS:
+        snprintf(buf, size, "rBoot Options:%s%s",
+                value & BOOT_LOG_OPT_BIG_FLASH ? " Big flash" : "",
+                value & BOOT_LOG_OPT_CONFIG_CHKSUM ? " Config chksum" : "");
+        break;
+    case BOOT_LOG_DEFAULT_CONFIG:
+        snprintf(buf, size, "Writing default boot config.");
+        break;
+    case BOOT_LOG_GPIO_BOOT:
+        snprintf(buf, size, "Booting GPIO-selected rom %u.", value);
+        break;
+    case BOOT_LOG_INVALID_ROM:
+        snprintf(buf, size, "Invalid rom %u selected, defaulting.", value);
+        break;
+    case BOOT_LOG_ROM_ADDR:
+        snprintf(buf, size, "ROM%u: 0x%08X", value >> 16, (value & 0xffff) << 12);
+        break;
+    case BOOT_LOG_ROM_BAD:
+        snprintf(buf, size, "Rom %u is bad.", value);
+        break;
+    case BOOT_LOG_NO_ROM:
+        snprintf(buf, size, "No good rom available.");
+        break;
+    case BOOT_LOG_BOOTING:
+        snprintf(buf, size, "Booting rom %u.", value);
+        break;
+    default:
+        snprintf(buf, size, "unknown record 0x%08x", record);
+        break;
     }
+}
+
+void rboot_clear_boot_log() {
+    uint32_t header = 0;
+    system_rtc_mem_write(BOOT_LOG_RTC_BLOCK, &header, sizeof(header));
+}
+
+
+/**
+ * Buffers for the update and config paths, see OTA_set_arena().
+ */
+
+#ifdef RBOOT_OTA_STATIC_ARENA
+static uint32_t static_arena[RBOOT_OTA_ARENA_SIZE / sizeof(uint32_t)];
+static uint8_t* arena_base = (uint8_t*)static_arena;
+static size_t arena_size = sizeof(static_arena);
+#else
+static uint8_t* arena_base = NULL;
+static size_t arena_size = 0;
+#endif
+static size_t arena_used = 0;
+
+void OTA_set_arena(void* arena, size_t size) {
+#ifdef RBOOT_OTA_STATIC_ARENA
+  if (!arena) {
+    arena = static_arena;
+    size = sizeof(static_arena);
   }
+#endif
+  arena_base = (uint8_t*)arena;
+  arena_size = arena ? size : 0;
+  arena_used = 0;
+}
+
+void* ota_alloc(size_t size) {
+  if (!arena_base) {
+    return os_malloc(size);
+  }
+  size = (size + 3) & ~3;
+  if (size > arena_size - arena_used) {
+    DEBUG("ota_alloc: %d bytes do not fit the arena", size);
+    return NULL;
+  }
+  void* ptr = arena_base + arena_used;
+  arena_used += size;
+  return ptr;
+}
 
+void ota_free(void* ptr) {
+  if (!arena_base) {
+    os_free(ptr);
+    return;
+  }
+  uint8_t* p = (uint8_t*)ptr;
+  if (p >= arena_base && p < arena_base + arena_used) {
+    arena_used = p - arena_base;
+  }
 }
 
 
@@ -131,8 +241,6 @@ extern "C" {
  * reboot.
  */
 
-#define OTA_BUF_SIZE     1536
-
 void OTA_update(IPAddress ip, uint16_t port, const char * url) {
   static bool in_progress = false;
     if (in_progress) {
@@ -143,9 +251,8 @@ void OTA_update(IPAddress ip, uint16_t port, const char * url) {
     DEBUG("OTA_update: ENTER");
 
     WiFiClient conn;
-    char* clen_pos;
-    uint16_t buf_head = 0;
-    uint8_t* buf;
+    const char* clen_pos;
+    uint8_t* buf = NULL;
     uint32_t current_addr;
 
     rboot_config bootconf = rboot_get_config();
@@ -156,161 +263,516 @@ void OTA_update(IPAddress ip, uint16_t port, const char * url) {
 
     DEBUG("running rom: %d, upgrade rom: %d", bootconf.current_rom, upgrade_slot);
 
-    if (current_addr % SECTOR_SIZE) {
-      DEBUG("Bad rom slot %d at 0x%x\r\n", bootconf.current_rom, current_addr);
+    if (!ota_check_slot(upgrade_slot, current_addr)) {
       goto bail;
     }
 
-    buf = (uint8_t*)os_malloc(OTA_BUF_SIZE);
+    buf = (uint8_t*)ota_alloc(OTA_BUF_SIZE);
     if (!buf) {
         DEBUG("OTA_update: buffer allocation failed");
         goto bail;
     }
 
     {   // because goto
-    int n = snprintf((char*)buf, OTA_BUF_SIZE,
-            "GET %s%d.bin HTTP/1.0\r\n"
-            "Connection: close\r\n"
-            "Cache-Control: no-cache\r\n"
-            "User-Agent: rBootOTA/0.1\r\n"
-            "Accept: */*\r\n\r\n", url, upgrade_slot);
-
-    if (n < 0 || n >= OTA_BUF_SIZE) {
-        DEBUG("OTA_update: header block too large, n=%d", n);
+    DEBUG(("OTA_update: connecting to " IPSTR ":%d\r\n"), IP2STR((uint32_t)ip), port);
+
+    int status = ota_http_get(conn, ip, port, (char*)buf, OTA_BUF_SIZE, "", "%s%d.bin", url, upgrade_slot);
+    if (status != 200) {
+        DEBUG("OTA_update: bad HTTP status %d", status);
         goto bail;
     }
 
-    DEBUG(("OTA_update: connecting to " IPSTR ":%d\r\n"), IP2STR((uint32_t)ip), port);
+    // extract content length
+    clen_pos = ota_http_header((const char*)buf, "Content-Length:");
+    if (clen_pos == NULL) {
+        DEBUG("OTA_update: no Content-Length header found");
+        goto bail;
+    }
 
-    if (!conn.connect(ip, port)) {
-        DEBUG("OTA_update: HTTP connection failed");
+    int rom_size = atoi(clen_pos);
+    if (!ota_check_size(upgrade_slot, rom_size)) {
+        DEBUG("OTA_update: bad rom size: %d", rom_size);
+        goto bail;
+    }
+
+    if (!ota_erase(current_addr, rom_size)) {
+        goto bail;
+    }
+
+    DEBUG("writing application to flash");
+    // read data from TCP, write to flash
+    if (ota_copy_body(conn, current_addr, rom_size, buf) != OTA_COPY_DONE) {
         goto bail;
     }
 
+    // release the buffer first, so the config commit fits the arena
+    ota_free(buf);
+    buf = NULL;
+
+    // update current rom slot and reboot
+    if (ota_boot_rom(upgrade_slot)) {
+        return;
+    }
+    }
+
+    bail:
+    DEBUG("OTA_update failed!");
+    in_progress = false;
+    if (buf) ota_free(buf);
+    if (conn && conn.connected()) conn.stop();
+    return;
+}
+
+
+/**
+ * Erase a whole rom slot
+ *
+ * Refuses the slot that's running. Takes the 64K block erase wherever the
+ * slot is block aligned, which is most of it.
+ */
+
+bool OTA_erase_slot(uint8_t slot) {
+    rboot_config bootconf = rboot_get_config();
+    if (slot == bootconf.current_rom || slot >= bootconf.count
+            || !ota_check_slot(slot, bootconf.roms[slot])) {
+        DEBUG("OTA_erase_slot: can't erase rom %d", slot);
+        return false;
+    }
+    return ota_erase(bootconf.roms[slot], layout_rom_size[slot]);
+}
+
+
+/**
+ * Image verification helpers shared by the OTA implementations.
+ */
+
+uint32_t ota_crc32(uint32_t crc, const uint8_t* data, size_t len) {
+    static const uint32_t nibble_table[16] = {
+        0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac,
+        0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+        0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c,
+        0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c,
+    };
+    crc = ~crc;
+    while (len--) {
+        crc ^= *data++;
+        crc = (crc >> 4) ^ nibble_table[crc & 0x0f];
+        crc = (crc >> 4) ^ nibble_table[crc & 0x0f];
+    }
+    return ~crc;
+}
+
+uint32_t ota_flash_crc32(uint32_t addr, uint32_t len, uint8_t* buf, size_t buf_size) {
+    uint32_t crc = 0;
+    buf_size &= ~3;
+    while (len) {
+        size_t chunk = len < buf_size ? len : buf_size;
+        // reads are done in whole words, the image size is a multiple of 4
+        SPIRead(addr, buf, (chunk + 3) & ~3);
+        crc = ota_crc32(crc, buf, chunk);
+        addr += chunk;
+        len -= chunk;
+        yield();
+    }
+    return crc;
+}
+
+// same layout as rom_header/section_header in rboot/rboot-private.h
+struct ota_rom_header {
+    uint8_t magic;
+    uint8_t count;
+    uint8_t flags1;
+    uint8_t flags2;
+    uint32_t entry;
+    // only present in the new (irom first) format
+    uint32_t add;
+    uint32_t len;
+};
+
+struct ota_section_header {
+    uint32_t address;
+    uint32_t length;
+};
+
+// same layout as rom_index/rom_index_section in rboot/rboot-private.h
+struct ota_rom_index {
+    uint32_t magic;
+    uint32_t length;
+    uint32_t digest;
+    uint8_t header[8];
+    uint32_t chksum;
+    struct {
+        uint32_t offset;
+        ota_section_header section;
+    } sections[16];
+    uint32_t crc;
+};
+
+#define ROM_MAGIC       0xe9
+#define ROM_MAGIC_NEW1  0xea
+#define ROM_MAGIC_NEW2  0x04
+
+#define ROM_INDEX_MAGIC 0x58444972
+#define ROM_INDEX_LEN(count) (offsetof(ota_rom_index, sections) + (count) * 12)
+
+// read the section index at offset in the rom at start and check its crc
+static bool read_index(uint32_t start, uint32_t offset, ota_rom_index* index) {
+    if (offset & 0x0f || SPIRead(start + offset, index, sizeof(ota_rom_index))) return false;
+    uint8_t count = index->header[1];
+    if (index->magic != ROM_INDEX_MAGIC || index->length != offset || index->header[0] != ROM_MAGIC
+            || count == 0 || count > 16) {
+        return false;
+    }
+    size_t len = ROM_INDEX_LEN(count);
+    return ota_crc32(0, (const uint8_t*)index, len) == *(uint32_t*)((uint8_t*)index + len);
+}
+
+// mirrors check_image() in rboot/rboot.c, so an image that passes here
+// will not be rejected by the boot loader. If the image has a section
+// index, see tools/romindex.py, it must agree with the walk and the crc32
+// digest of the whole image has to match. A damaged index is ignored, as
+// rboot does, and the image is checked by the walk alone.
+bool ota_check_image(uint32_t readpos) {
+    uint32_t buf[64];
+    ota_rom_header* header = (ota_rom_header*)buf;
+    ota_section_header* section = (ota_section_header*)buf;
+    uint8_t chksum = CHKSUM_INIT;
+    uint32_t start = readpos;
+    uint32_t index_offset = 0;
+    ota_rom_index index;
+
+    if (SPIRead(readpos, header, sizeof(ota_rom_header))) return false;
+
+    if (header->magic == ROM_MAGIC_NEW1 && header->count == ROM_MAGIC_NEW2) {
+        index_offset = header->add;
+        if (index_offset && !read_index(start, index_offset, &index)) {
+            DEBUG("ota_check_image: bad section index, ignored");
+            index_offset = 0;
+        }
+        readpos += header->len + sizeof(ota_rom_header);
+        if (SPIRead(readpos, header, 8)) return false;
+    }
+    if (header->magic != ROM_MAGIC) {
+        DEBUG("ota_check_image: bad magic 0x%02x", header->magic);
+        return false;
+    }
+    if (index_offset && memcmp(header, index.header, 8) != 0) {
+        DEBUG("ota_check_image: rom header does not match the index");
+        return false;
+    }
+    readpos += 8;
+
+    // buf is reused for the sections from here on
+    uint8_t sectcount = header->count;
+    for (uint8_t sectnum = 0; sectnum < sectcount; sectnum++) {
+        if (SPIRead(readpos, section, sizeof(ota_section_header))) return false;
+        readpos += sizeof(ota_section_header);
+        if (index_offset && (index.sections[sectnum].offset != readpos - start
+                || memcmp(section, &index.sections[sectnum].section, sizeof(ota_section_header)) != 0)) {
+            DEBUG("ota_check_image: section %d does not match the index", sectnum);
+            return false;
+        }
+
+        uint32_t remaining = section->length;
+        while (remaining > 0) {
+            uint32_t readlen = remaining < sizeof(buf) ? remaining : sizeof(buf);
+            if (SPIRead(readpos, buf, readlen)) return false;
+            readpos += readlen;
+            remaining -= readlen;
+            for (uint32_t i = 0; i < readlen; i++) {
+                chksum ^= ((uint8_t*)buf)[i];
+            }
+        }
+    }
+
+    // checksum is the last byte of the next 16 byte boundary
+    if (SPIRead(readpos & ~0x0f, buf, 16)) return false;
+    if (((uint8_t*)buf)[15] != chksum) {
+        DEBUG("ota_check_image: bad checksum");
+        return false;
+    }
+
+    if (index_offset) {
+        if ((uint8_t)index.chksum != chksum || (readpos | 0x0f) - start >= index.length) {
+            DEBUG("ota_check_image: checksum does not match the index");
+            return false;
+        }
+        if (ota_flash_crc32(start, index.length, (uint8_t*)buf, sizeof(buf)) != index.digest) {
+            DEBUG("ota_check_image: bad digest");
+            return false;
+        }
+    }
+    return true;
+}
+
+
+/**
+ * HTTP and flash helpers shared by the OTA implementations.
+ */
+
+int ota_http_get(WiFiClient& conn, IPAddress ip, uint16_t port, char* buf, size_t size,
+        const char* extra, const char* path_fmt, ...) {
+    va_list args;
+    int n = snprintf(buf, size, "GET ");
+    va_start(args, path_fmt);
+    n += vsnprintf(buf + n, size - n, path_fmt, args);
+    va_end(args);
+    if (n < (int)size) {
+        n += snprintf(buf + n, size - n, " HTTP/1.0\r\n"
+                "Connection: close\r\n"
+                "Cache-Control: no-cache\r\n"
+                "User-Agent: rBootOTA/0.1\r\n"
+                "Accept: */*\r\n%s\r\n", extra);
+    }
+    if (n < 0 || n >= (int)size) {
+        DEBUG("ota_http_get: header block too large, n=%d", n);
+        return -1;
+    }
+
+    if (!conn.connect(ip, port)) {
+        DEBUG("ota_http_get: HTTP connection failed");
+        return -1;
+    }
+
     yield();
 
     // send the request
     conn.write((const uint8_t *)buf, n);
-    os_memset(buf, 0, OTA_BUF_SIZE);
+    DEBUG("ota_http_get: request sent.");
 
-    DEBUG("OTA_update: request sent.");
+    int len = ota_http_read_headers(conn, buf, size);
+    if (len < 12 || os_strncmp(buf, "HTTP/", 5) != 0) {
+        DEBUG("ota_http_get: not an HTTP response");
+        return -1;
+    }
+    return atoi(buf + 9);
+}
 
+int ota_http_read_headers(WiFiClient& conn, char* buf, size_t size) {
     // buffer in the header block
     uint32_t start = millis();
-
-    buf_head = 0;
+    size_t buf_head = 0;
     while (buf_head < 4 || memcmp(buf+buf_head-4, "\r\n\r\n", 4) != 0) {
         if (conn.available()) {
-            buf[buf_head++] = (uint8_t) conn.read();
-            if (buf_head >= OTA_BUF_SIZE) {
-                DEBUG("OTA_update: buffer overflow while reading headers");
-                goto bail;
+            buf[buf_head++] = (char) conn.read();
+            if (buf_head >= size) {
+                DEBUG("ota_http_read_headers: buffer overflow while reading headers");
+                return -1;
             }
             continue;
         }
         if ((millis() - start) > 3000) {
-            DEBUG("OTA_update: read headers timeout");
-            goto bail;
+            DEBUG("ota_http_read_headers: read headers timeout");
+            return -1;
         }
+        yield();
     }
+    buf[buf_head] = 0;
+    return buf_head;
+}
 
-    // extract content length
-    clen_pos = os_strstr((const char*)buf, "Content-Length:");
-    if (clen_pos == NULL) {
-        DEBUG("OTA_update: no Content-Length header found");
-        goto bail;
+const char* ota_http_header(const char* headers, const char* name) {
+    const char* pos = os_strstr(headers, name);
+    if (pos == NULL) {
+        return NULL;
+    }
+    pos += os_strlen(name);
+    while (*pos == ' ') {
+        pos++;
     }
+    return pos;
+}
 
-    int rom_size = atoi(clen_pos+15);
-    if (rom_size < 250 || rom_size >= 0x79000 || rom_size % 4) {
-        DEBUG("OTA_update: bad rom size: %d", rom_size);
-        goto bail;
+bool ota_http_validator(const char* headers, char* out, size_t size) {
+    const char* value = ota_http_header(headers, "ETag:");
+    if (value == NULL) {
+        value = ota_http_header(headers, "Last-Modified:");
+    }
+    out[0] = 0;
+    if (value == NULL) {
+        return false;
+    }
+    size_t len = 0;
+    while (value[len] && value[len] != '\r' && value[len] != '\n') {
+        len++;
+    }
+    if (len == 0 || len >= size) {
+        return false;
+    }
+    os_memcpy(out, value, len);
+    out[len] = 0;
+    return true;
+}
+
+int ota_http_range_total(const char* headers) {
+    const char* pos = ota_http_header(headers, "Content-Range:");
+    if (pos == NULL) {
+        return -1;
     }
+    pos = os_strstr(pos, "/");
+    if (pos == NULL || pos[1] < '0' || pos[1] > '9') {
+        return -1;
+    }
+    return atoi(pos + 1);
+}
 
-    size_t remaining = rom_size;
-    memset(buf, 0, OTA_BUF_SIZE);
-    buf_head = 0;
+bool ota_http_range(const char* headers, uint32_t* first, uint32_t* last) {
+    const char* pos = ota_http_header(headers, "Content-Range:");
+    char* end;
+    if (pos == NULL || os_strncmp(pos, "bytes ", 6) != 0 || pos[6] < '0' || pos[6] > '9') {
+        return false;
+    }
+    *first = strtoul(pos + 6, &end, 10);
+    if (end[0] != '-' || end[1] < '0' || end[1] > '9') {
+        return false;
+    }
+    *last = strtoul(end + 1, &end, 10);
+    return *end == '/' && *first <= *last;
+}
 
-    uint32_t rounded_size = (rom_size + SECTOR_SIZE - 1) & (~(SECTOR_SIZE - 1));
-    DEBUG("flash erase @0x%x size=0x%x", current_addr, rounded_size);
+void ota_config_sector_read(uint32_t offset, void* data, size_t len) {
+    WDT_FEED();
     noInterrupts();
-    int rc = SPIEraseAreaEx(current_addr, rounded_size);
+    spi_flash_read(BOOT_CONFIG_SECTOR * SECTOR_SIZE + offset, (uint32*)data, len);
     interrupts();
-    if (rc) {
-        DEBUG("erasing flash failed: %d", rc);
-        goto bail;
+}
+
+bool ota_config_sector_write(uint32_t offset, const void* data, size_t len) {
+    uint8_t* buffer = (uint8_t*)ota_alloc(SECTOR_SIZE);
+    if (!buffer) {
+        DEBUG("No ram!\r\n");
+        return false;
     }
 
-    DEBUG("writing application to flash");
-    // read data from TCP, write to flash, erasing sectors as needed
-    start = millis();
-    while (remaining) {
+    WDT_FEED();
+    noInterrupts();
+    spi_flash_read(BOOT_CONFIG_SECTOR * SECTOR_SIZE, (uint32*)buffer, SECTOR_SIZE);
+    interrupts();
 
-        yield();
+    os_memcpy(buffer + offset, data, len);
 
-        if (!conn.connected()) {
-            DEBUG("OTA_update: connection died.");
-            goto bail;
-        }
+    noInterrupts();
+    spi_flash_erase_sector(BOOT_CONFIG_SECTOR);
+    interrupts();
 
-        if ((millis() - start) > 60000) {
-            // an update will timeout eventually
-            DEBUG("timeout while reading data");
-            goto bail;
+    noInterrupts();
+    spi_flash_write(BOOT_CONFIG_SECTOR * SECTOR_SIZE, (uint32*)buffer, SECTOR_SIZE);
+    interrupts();
+
+    ota_free(buffer);
+    return true;
+}
+
+bool ota_check_slot(uint8_t slot, uint32_t addr) {
+    if (slot >= LAYOUT_ROM_COUNT || addr != layout_rom_addr[slot]) {
+        DEBUG("Bad rom slot %d at 0x%x\r\n", slot, addr);
+        return false;
+    }
+    return true;
+}
+
+bool ota_check_size(uint8_t slot, int size) {
+    return size >= 250 && size % 4 == 0
+        && slot < LAYOUT_ROM_COUNT && (uint32_t)size <= layout_rom_size[slot];
+}
+
+uint32_t ota_erase_size(uint32_t addr, uint32_t end) {
+    for (uint32_t size = OTA_ERASE_BLOCK_SIZE; size > SECTOR_SIZE; size >>= 1) {
+        if ((OTA_ERASE_SIZES & size) && (addr & (size - 1)) == 0 && end - addr >= size) {
+            return size;
         }
+    }
+    return SECTOR_SIZE;
+}
 
-        if (!conn.available()) {
-            continue;
+bool ota_erase(uint32_t addr, uint32_t len) {
+    uint32_t end = addr + ((len + SECTOR_SIZE - 1) & (~(SECTOR_SIZE - 1)));
+    DEBUG("flash erase @0x%x size=0x%x", addr, end - addr);
+    while (addr < end) {
+        uint32_t size = ota_erase_size(addr, end);
+        int rc;
+        // one command at a time, so interrupts get a look in between
+        WDT_FEED();
+        noInterrupts();
+        if (size == OTA_ERASE_BLOCK_SIZE) {
+            rc = SPIEraseBlock(addr / OTA_ERASE_BLOCK_SIZE);
+        } else if (size == SECTOR_SIZE) {
+            rc = SPIEraseSector(addr / SECTOR_SIZE);
+        } else {
+            // never skip ahead over something that wasn't erased
+            rc = -1;
         }
+        interrupts();
+        if (rc) {
+            DEBUG("erasing flash @0x%x size=0x%x failed: %d", addr, size, rc);
+            return false;
+        }
+        addr += size;
+    }
+    return true;
+}
 
-        while (size_t available = conn.available()) {
-            if (available > remaining) {
-                DEBUG("OTA_update: got more than asked for?!?!");
-            }
+int32_t ota_copy_to_flash(WiFiClient& conn, uint32_t addr, uint32_t max_len, uint8_t* buf) {
+    size_t available = conn.available();
+    // min and max are undef-d in ESP8266WiFiMulti...
+    size_t chunk_len = available < OTA_BUF_SIZE ? available : OTA_BUF_SIZE;
+    if (chunk_len > max_len) {
+        chunk_len = max_len;
+    }
+    // align to 4 bytes, the rest stays in the socket for next time
+    chunk_len &= ~3;
+    if (chunk_len == 0) {
+        return 0;
+    }
 
-            // min and max are undef-d in ESP8266WiFiMulti...
-            // size_t chunk_len = min(available, OTA_BUF_SIZE);
-            // size_t chunk_len = std::min((const size_t)available, (const size_t)OTA_BUF_SIZE);
-            size_t chunk_len = available < OTA_BUF_SIZE ? available : OTA_BUF_SIZE;
-            // align to 4 bytes
-            uint8_t leftover = chunk_len % 4;
-            chunk_len -= leftover;
-
-            size_t got = conn.readBytes(buf, chunk_len);
-            if (got != chunk_len) {
-                DEBUG("read %d instead of %d, connection failed", got, chunk_len);
-                goto bail;
-            }
-            remaining -= chunk_len;
+    size_t got = conn.readBytes(buf, chunk_len);
+    if (got != chunk_len) {
+        DEBUG("read %d instead of %d, connection failed", got, chunk_len);
+        return -1;
+    }
 
-            // DEBUG("WRITE 0x%x, %d", current_addr, chunk_len);
-            if (int res = SPIWrite(current_addr, buf, chunk_len)) {
-                DEBUG("flash write failed: %d", res);
-                goto bail;
-            }
-            current_addr += chunk_len;
-            DEBUG("c %d r %d a %d", chunk_len, remaining, available);
+    if (SPIWrite(addr, buf, chunk_len)) {
+        DEBUG("flash write failed at 0x%x", addr);
+        return -1;
+    }
+    return chunk_len;
+}
+
+int ota_copy_body(WiFiClient& conn, uint32_t addr, uint32_t len, uint8_t* buf) {
+    uint32_t start = millis();
+    while (len) {
+        yield();
+
+        if ((millis() - start) > OTA_BODY_TIMEOUT) {
+            DEBUG("timeout while reading data");
+            return OTA_COPY_TIMEOUT;
+        }
+
+        int32_t written = ota_copy_to_flash(conn, addr, len, buf);
+        if (written < 0) {
+            return OTA_COPY_FAILED;
         }
+        if (written == 0 && !conn.connected()) {
+            DEBUG("connection died with %d bytes to go", len);
+            return OTA_COPY_CLOSED;
+        }
+        len -= written;
+        addr += written;
     }
+    return OTA_COPY_DONE;
+}
 
-    // remaining should be 0 here
-    if (remaining != 0) {
-        DEBUG("have remaining=%d", remaining);
-        goto bail;
+bool ota_boot_rom(uint8_t slot) {
+    if (!rboot_set_current_rom(slot)) {
+        DEBUG("could not write boot config");
+        return false;
     }
+    ota_restart();
+    return true;
+}
 
-    // update current rom slot and reboot
-    rboot_set_current_rom(upgrade_slot);
-    DEBUG("UPGGRADE COMPLETED.\r\nWill boot rom %d", rboot_get_current_rom());
+void ota_restart() {
+    DEBUG("UPGRADE COMPLETED.\r\nWill boot rom %d", rboot_get_current_rom());
     delay(100);
     ESP.restart();
-    return;
-    }
-
-    bail:
-    DEBUG("OTA_update failed!");
-    in_progress = false;
-    if (buf) os_free(buf);
-    if (conn && conn.connected()) conn.stop();
-    return;
 }
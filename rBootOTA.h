@@ -6,6 +6,10 @@
 #include "Arduino.h"
 #include "IPAddress.h"
 
+// uncomment to serve all OTA and boot config buffers from a statically
+// reserved arena of RBOOT_OTA_ARENA_SIZE bytes instead of the heap
+//#define RBOOT_OTA_STATIC_ARENA
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -32,4 +36,84 @@ bool rboot_set_current_rom(uint8 rom);
 
 void OTA_update(IPAddress ip, uint16_t port, const char * url);
 
+// Boot log left in rtc memory by an rboot built with BOOT_QUIET, see
+// rboot/rboot.h. Copies up to max records, oldest first, and returns how
+// many were copied.
+uint8_t rboot_get_boot_log(uint32_t* records, uint8_t max);
+// one record as the line rboot would have printed for it
+void rboot_format_boot_log(uint32_t record, char* buf, size_t size);
+void rboot_clear_boot_log();
+
+// Same as OTA_update(), but fetch the image as up to OTA_MAX_STREAMS
+// concurrent HTTP Range requests, each into its own part of the upgrade
+// slot. A single lwIP connection is window limited, on high latency links
+// this gets closer to the real bandwidth. The server must support Range
+// requests, python's http.server does not.
+#define OTA_MAX_STREAMS 3
+void OTA_update_ranged(IPAddress ip, uint16_t port, const char * url, uint8_t streams);
+
+// Push mode, for provisioning: serve "GET path", answering with the
+// upgrade slot number, and "POST path" with the rom for that slot as the
+// body and the slot number in an X-Rom-Slot header (required, a rom
+// linked for the other slot would pass every check and then crash). The
+// body is streamed to flash as it arrives, verified, the slot switched,
+// and only then the crc32 of what ended up in flash sent back before
+// rebooting. Call OTA_push_loop() from loop(). See tools/ota_push.py.
+void OTA_push_begin(uint16_t port, const char * path);
+void OTA_push_loop();
+
+// Background staging. OTA_stage_loop(), called from loop(), trickles the
+// image for the upgrade slot in at no more than bytes_per_sec, a chunk at
+// a time, so the application keeps running and keeps its bandwidth.
+// Progress is checkpointed at OTA_STAGE_STATE_OFFSET in the boot config
+// sector (keep your own data there clear of it) and staging picks up where
+// it left off after a reboot when begun again with the same server and
+// url, as long as the server still has the same image. That's told by its
+// ETag or Last-Modified, sent back as If-Range, without either staging
+// starts over on every reconnect. Once OTA_STAGE_READY, OTA_stage_activate()
+// switches over whenever the application decides it's a good time.
+#define OTA_STAGE_IDLE      0
+#define OTA_STAGE_RUNNING   1
+#define OTA_STAGE_PAUSED    2
+#define OTA_STAGE_READY     3   // complete and verified
+#define OTA_STAGE_FAILED    4
+
+#define OTA_STAGE_STATE_OFFSET  0xf00
+
+bool OTA_stage_begin(IPAddress ip, uint16_t port, const char * url, uint32_t bytes_per_sec);
+uint8_t OTA_stage_loop();
+void OTA_stage_pause(bool pause);
+bool OTA_stage_activate();
+
+// Poll for updates. Fetches the manifest written by "make" next to the
+// roms (version, size, crc32 and url of each rom, see tools/mkmanifest.py)
+// with If-None-Match or If-Modified-Since from the last time, so an
+// unchanged server answers with just a 304. If the manifest's version
+// isn't current_version the rom for the upgrade slot is downloaded from
+// the same server, verified against it and booted, as in OTA_update().
+// A version that failed is skipped until the manifest names another one.
+// Rom urls not starting with / are relative to manifest_url.
+#define OTA_CHECK_ERROR     -1
+#define OTA_CHECK_NO_UPDATE  0
+
+int OTA_check_update(IPAddress ip, uint16_t port, const char * manifest_url,
+        const char * current_version);
+
+// Erase rom slot, anything but the running one. Returns false for the
+// running slot or a failed erase.
+bool OTA_erase_slot(uint8_t slot);
+
+// Worst case RAM the update and config commit paths need from the arena.
+// Update buffers are released before the config is committed, except for
+// the staging checkpoints which hold the download buffer while writing
+// their copy of the config sector. Sockets and lwIP buffers are still
+// allocated by the SDK.
+#define RBOOT_OTA_ARENA_SIZE (SECTOR_SIZE + 1536)
+
+// Use arena (4 byte aligned, at least RBOOT_OTA_ARENA_SIZE bytes) for all
+// OTA and config buffers from now on, none of them come from the heap
+// then (the SDK's own socket buffers still do). Pass NULL to go back to
+// the heap, or to the static arena if it's enabled.
+void OTA_set_arena(void* arena, size_t size);
+
 #endif //_RBOOT_OTA_H
@@ -0,0 +1,172 @@
+//Add proper header
+
+#include <Arduino.h>
+#include <IPAddress.h>
+#include <ESP8266WiFi.h>
+
+#include "rBootOTA.h"
+#include "rBootOTA-private.h"
+#include "flash_utils.h"
+
+extern "C" {
+  #include "c_types.h"
+  #include "osapi.h"
+}
+
+static WiFiServer* push_server = NULL;
+static const char* push_path = NULL;
+
+void OTA_push_begin(uint16_t port, const char * path) {
+    if (push_server) {
+        return;
+    }
+    // constructed on the first call, not with new, so it stays off the heap
+    // with an arena set. Only the port of that call counts.
+    static WiFiServer server(port);
+    push_path = path;
+    push_server = &server;
+    push_server->begin();
+    DEBUG("OTA_push: listening on port %d", port);
+}
+
+static void push_respond(WiFiClient& conn, const char* status, const char* body) {
+    char head[96];
+    int n = snprintf(head, sizeof(head), "HTTP/1.0 %s\r\n"
+            "Connection: close\r\n"
+            "Content-Type: text/plain\r\n"
+            "Content-Length: %d\r\n\r\n", status, (int)os_strlen(body));
+    conn.write((const uint8_t*)head, n);
+    conn.write((const uint8_t*)body, os_strlen(body));
+}
+
+// request line is "<method> <path> HTTP/1.x"
+static bool push_is_request(const char* headers, const char* method) {
+    size_t len = os_strlen(method);
+    if (os_strncmp(headers, method, len) != 0 || headers[len] != ' ') {
+        return false;
+    }
+    headers += len + 1;
+    len = os_strlen(push_path);
+    return os_strncmp(headers, push_path, len) == 0 && headers[len] == ' ';
+}
+
+// stream the body to the upgrade slot and verify it. Returns the slot,
+// with the response to send once it's committed in body, or -1 after
+// answering why not.
+static int push_receive(WiFiClient& conn, uint8_t* buf, char* body, size_t body_size) {
+    const char* value;
+
+    rboot_config bootconf = rboot_get_config();
+    uint8_t upgrade_slot = bootconf.current_rom == 0 ? 1 : 0;
+    uint32_t slot_addr = bootconf.roms[upgrade_slot];
+
+    if (!ota_check_slot(upgrade_slot, slot_addr)) {
+        push_respond(conn, "500 Internal Server Error", "bad rom slot\r\n");
+        return -1;
+    }
+
+    // roms are linked for their slot and nothing in the image says which,
+    // so the sender has to
+    value = ota_http_header((const char*)buf, "X-Rom-Slot:");
+    if (value == NULL || *value < '0' || *value > '9') {
+        push_respond(conn, "400 Bad Request", "X-Rom-Slot header required\r\n");
+        return -1;
+    }
+    if (atoi(value) != upgrade_slot) {
+        snprintf(body, body_size, "expected rom %d\r\n", upgrade_slot);
+        push_respond(conn, "409 Conflict", body);
+        return -1;
+    }
+
+    value = ota_http_header((const char*)buf, "Content-Length:");
+    int rom_size = value ? atoi(value) : -1;
+    if (!ota_check_size(upgrade_slot, rom_size)) {
+        DEBUG("OTA_push: bad rom size: %d", rom_size);
+        push_respond(conn, "400 Bad Request", "bad rom size\r\n");
+        return -1;
+    }
+
+    if (os_strstr((const char*)buf, "Expect: 100-continue")) {
+        conn.print("HTTP/1.1 100 Continue\r\n\r\n");
+    }
+
+    if (!ota_erase(slot_addr, rom_size)) {
+        push_respond(conn, "500 Internal Server Error", "erase failed\r\n");
+        return -1;
+    }
+
+    DEBUG("OTA_push: writing %d bytes to rom %d", rom_size, upgrade_slot);
+    switch (ota_copy_body(conn, slot_addr, rom_size, buf)) {
+    case OTA_COPY_DONE:
+        break;
+    case OTA_COPY_TIMEOUT:
+        push_respond(conn, "408 Request Timeout", "timeout\r\n");
+        return -1;
+    case OTA_COPY_FAILED:
+        push_respond(conn, "500 Internal Server Error", "flash write failed\r\n");
+        return -1;
+    default:
+        // nobody left to answer
+        return -1;
+    }
+
+    uint32_t crc = ota_flash_crc32(slot_addr, rom_size, buf, OTA_BUF_SIZE);
+    if (!ota_check_image(slot_addr)) {
+        snprintf(body, body_size, "crc32=%08x\r\nbad image checksum\r\n", crc);
+        push_respond(conn, "422 Unprocessable Entity", body);
+        return -1;
+    }
+
+    snprintf(body, body_size, "crc32=%08x\r\nrom=%d\r\n", crc, upgrade_slot);
+    return upgrade_slot;
+}
+
+void OTA_push_loop() {
+    if (!push_server) {
+        return;
+    }
+    WiFiClient conn = push_server->available();
+    if (!conn) {
+        return;
+    }
+
+    uint8_t* buf = (uint8_t*)ota_alloc(OTA_BUF_SIZE);
+    if (!buf) {
+        DEBUG("OTA_push: buffer allocation failed");
+        push_respond(conn, "503 Service Unavailable", "out of memory\r\n");
+        conn.stop();
+        return;
+    }
+
+    if (ota_http_read_headers(conn, (char*)buf, OTA_BUF_SIZE) < 0) {
+        push_respond(conn, "400 Bad Request", "bad request\r\n");
+    } else if (push_is_request((const char*)buf, "GET")) {
+        char body[8];
+        snprintf(body, sizeof(body), "%d\r\n", rboot_get_current_rom() == 0 ? 1 : 0);
+        push_respond(conn, "200 OK", body);
+    } else if (push_is_request((const char*)buf, "POST")) {
+        char body[48];
+        int slot = push_receive(conn, buf, body, sizeof(body));
+        if (slot >= 0) {
+            // release the buffer first, so the config commit fits the arena
+            ota_free(buf);
+            buf = NULL;
+
+            // only report success once the slot is switched
+            if (!rboot_set_current_rom(slot)) {
+                DEBUG("OTA_push: could not write boot config");
+                push_respond(conn, "500 Internal Server Error", "could not write boot config\r\n");
+            } else {
+                push_respond(conn, "200 OK", body);
+                conn.stop();
+                ota_restart();
+                return;
+            }
+        }
+    } else {
+        push_respond(conn, "404 Not Found", "not found\r\n");
+    }
+
+    conn.stop();
+    if (buf) ota_free(buf);
+}
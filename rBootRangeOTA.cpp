@@ -0,0 +1,175 @@
+//Add proper header
+
+#include <Arduino.h>
+#include <IPAddress.h>
+#include <ESP8266WiFi.h>
+
+#include "rBootOTA.h"
+#include "rBootOTA-private.h"
+#include "flash_utils.h"
+
+extern "C" {
+  #include "c_types.h"
+  #include "osapi.h"
+  #include "ip_addr.h"
+}
+
+// part of the image fetched by one connection, offsets into the image
+struct ota_region {
+    uint32_t start;
+    uint32_t end;
+    uint32_t pos;   // next offset to write
+};
+
+/**
+ * Perform an OTA update over several HTTP connections
+ *
+ * Ask for the first byte to learn the image size, then split the image
+ * into sector aligned regions and fetch each with its own Range request.
+ * Data is written as it arrives on any of the connections. Once every
+ * region is complete the whole image is checked. If successful -- update
+ * the rboot config and reboot.
+ */
+
+void OTA_update_ranged(IPAddress ip, uint16_t port, const char * url, uint8_t streams) {
+    static bool in_progress = false;
+    if (in_progress) {
+        DEBUG("OTA_ranged: already updating!");
+        return;
+    }
+    in_progress = true;
+    DEBUG("OTA_ranged: ENTER");
+
+    WiFiClient conns[OTA_MAX_STREAMS];
+    ota_region regions[OTA_MAX_STREAMS];
+    char range[48];
+    int status, rom_size;
+    uint32_t part, start, first, last;
+    uint8_t* buf = NULL;
+
+    if (streams < 1) streams = 1;
+    if (streams > OTA_MAX_STREAMS) streams = OTA_MAX_STREAMS;
+
+    rboot_config bootconf = rboot_get_config();
+    uint8_t upgrade_slot = bootconf.current_rom == 0 ? 1 : 0;
+    uint32_t slot_addr = bootconf.roms[upgrade_slot];
+
+    if (!ota_check_slot(upgrade_slot, slot_addr)) {
+        goto bail;
+    }
+
+    buf = (uint8_t*)ota_alloc(OTA_BUF_SIZE);
+    if (!buf) {
+        DEBUG("OTA_ranged: buffer allocation failed");
+        goto bail;
+    }
+
+    DEBUG(("OTA_ranged: connecting to " IPSTR ":%d\r\n"), IP2STR((uint32_t)ip), port);
+
+    status = ota_http_get(conns[0], ip, port, (char*)buf, OTA_BUF_SIZE,
+            "Range: bytes=0-0\r\n", "%s%d.bin", url, upgrade_slot);
+    conns[0].stop();
+    if (status != 206) {
+        DEBUG("OTA_ranged: no Range support, HTTP status %d", status);
+        goto bail;
+    }
+
+    rom_size = ota_http_range_total((const char*)buf);
+    if (!ota_check_size(upgrade_slot, rom_size)) {
+        DEBUG("OTA_ranged: bad rom size: %d", rom_size);
+        goto bail;
+    }
+
+    if (!ota_erase(slot_addr, rom_size)) {
+        goto bail;
+    }
+
+    // sector aligned parts, the last one takes what is left
+    part = ((rom_size / streams) + SECTOR_SIZE - 1) & (~(SECTOR_SIZE - 1));
+    for (uint8_t i = 0; i < streams; i++) {
+        regions[i].start = regions[i].pos = i * part;
+        regions[i].end = (i + 1) * part < (uint32_t)rom_size ? (i + 1) * part : rom_size;
+        if (regions[i].start >= regions[i].end) {
+            streams = i;
+            break;
+        }
+
+        snprintf(range, sizeof(range), "Range: bytes=%u-%u\r\n",
+                regions[i].start, regions[i].end - 1);
+        status = ota_http_get(conns[i], ip, port, (char*)buf, OTA_BUF_SIZE,
+                range, "%s%d.bin", url, upgrade_slot);
+        if (status != 206) {
+            DEBUG("OTA_ranged: bad HTTP status %d for region %d", status, i);
+            goto bail;
+        }
+        // anything else would land in the wrong place in the slot
+        if (!ota_http_range((const char*)buf, &first, &last)
+                || first != regions[i].start || last != regions[i].end - 1) {
+            DEBUG("OTA_ranged: server sent another range for region %d", i);
+            goto bail;
+        }
+        DEBUG("OTA_ranged: region %d 0x%x-0x%x", i, regions[i].start, regions[i].end);
+    }
+
+    DEBUG("writing application to flash");
+    start = millis();
+    for (;;) {
+        bool complete = true;
+
+        yield();
+
+        if ((millis() - start) > OTA_BODY_TIMEOUT) {
+            DEBUG("timeout while reading data");
+            goto bail;
+        }
+
+        for (uint8_t i = 0; i < streams; i++) {
+            ota_region* r = &regions[i];
+            if (r->pos == r->end) {
+                continue;
+            }
+            complete = false;
+
+            int32_t written = ota_copy_to_flash(conns[i], slot_addr + r->pos, r->end - r->pos, buf);
+            if (written < 0) {
+                goto bail;
+            }
+            if (written == 0 && !conns[i].connected()) {
+                DEBUG("OTA_ranged: connection %d died at 0x%x", i, r->pos);
+                goto bail;
+            }
+            r->pos += written;
+            if (r->pos == r->end) {
+                DEBUG("OTA_ranged: region %d complete", i);
+                conns[i].stop();
+            }
+        }
+
+        if (complete) {
+            break;
+        }
+    }
+
+    if (!ota_check_image(slot_addr)) {
+        DEBUG("OTA_ranged: image checksum mismatch");
+        goto bail;
+    }
+
+    // release the buffer first, so the config commit fits the arena
+    ota_free(buf);
+    buf = NULL;
+
+    // update current rom slot and reboot
+    if (ota_boot_rom(upgrade_slot)) {
+        return;
+    }
+
+    bail:
+    DEBUG("OTA_ranged failed!");
+    in_progress = false;
+    if (buf) ota_free(buf);
+    for (uint8_t i = 0; i < OTA_MAX_STREAMS; i++) {
+        if (conns[i].connected()) conns[i].stop();
+    }
+    return;
+}
@@ -0,0 +1,326 @@
+//Add proper header
+
+#include <Arduino.h>
+#include <IPAddress.h>
+#include <ESP8266WiFi.h>
+
+#include "rBootOTA.h"
+#include "rBootOTA-private.h"
+#include "flash_utils.h"
+
+extern "C" {
+  #include "c_types.h"
+  #include "osapi.h"
+}
+
+#define OTA_STAGE_MAGIC         0x53544732  // "STG2"
+
+// persist progress every this many bytes, each costs a config sector erase
+#define OTA_STAGE_CHECKPOINT    0x10000
+
+// wait this long before reconnecting after a failure
+#define OTA_STAGE_RETRY         10000
+
+// longest ETag or Last-Modified we can resume by
+#define OTA_STAGE_VALIDATOR_SIZE 64
+
+// staging progress kept in the boot config sector
+struct ota_stage_state {
+    uint32_t magic;
+    uint32_t source;    // crc32 of server address, port and url
+    uint8_t  slot;
+    uint8_t  ready;     // image complete and verified
+    uint16_t unused;
+    uint32_t size;      // image size, 0 until the server told us
+    uint32_t done;      // sector aligned, everything below is written
+    char validator[OTA_STAGE_VALIDATOR_SIZE];  // ETag or Last-Modified of the image, may be empty
+    uint32_t crc;       // of the fields above
+};
+
+static_assert(OTA_STAGE_STATE_OFFSET % 4 == 0 &&
+        OTA_STAGE_STATE_OFFSET + sizeof(ota_stage_state) <= SECTOR_SIZE,
+        "staging state does not fit the config sector");
+
+static struct {
+    uint8_t state;
+    IPAddress ip;
+    uint16_t port;
+    const char* url;
+    uint32_t rate;          // bytes per second
+    uint32_t tokens;        // bytes we may move right now
+    uint32_t last_refill;
+    uint32_t retry_at;      // 0 when not waiting to retry
+    uint32_t slot_addr;
+    uint32_t pos;           // next image offset to write
+    uint32_t erased_to;     // image offset up to which flash is erased
+    uint8_t* buf;
+    ota_stage_state saved;
+} stage;
+
+static WiFiClient stage_conn;
+
+static uint32_t state_crc(const ota_stage_state* s) {
+    return ota_crc32(0, (const uint8_t*)s, offsetof(ota_stage_state, crc));
+}
+
+static bool stage_save() {
+    stage.saved.crc = state_crc(&stage.saved);
+    return ota_config_sector_write(OTA_STAGE_STATE_OFFSET, &stage.saved, sizeof(ota_stage_state));
+}
+
+static void stage_release() {
+    if (stage_conn.connected()) stage_conn.stop();
+    if (stage.buf) ota_free(stage.buf);
+    stage.buf = NULL;
+}
+
+static void stage_fail() {
+    DEBUG("OTA_stage: failed at 0x%x", stage.pos);
+    stage_release();
+    stage.state = OTA_STAGE_FAILED;
+}
+
+static void stage_retry() {
+    DEBUG("OTA_stage: retrying from 0x%x", stage.pos);
+    stage_conn.stop();
+    stage.retry_at = millis() + OTA_STAGE_RETRY;
+    if (stage.retry_at == 0) stage.retry_at = 1;
+}
+
+static void stage_restart(uint32_t size) {
+    DEBUG("OTA_stage: image changed, starting over");
+    stage.pos = stage.erased_to = 0;
+    stage.saved.size = size;
+    stage.saved.done = 0;
+    stage.saved.ready = 0;
+    stage.saved.validator[0] = 0;
+}
+
+// (re)open the connection at the current position
+static bool stage_connect() {
+    char extra[40 + OTA_STAGE_VALIDATOR_SIZE];
+    char validator[OTA_STAGE_VALIDATOR_SIZE];
+    int status, size;
+
+    if (!stage.buf) {
+        stage.buf = (uint8_t*)ota_alloc(OTA_BUF_SIZE);
+        if (!stage.buf) {
+            DEBUG("OTA_stage: buffer allocation failed");
+            return false;
+        }
+    }
+
+    if (stage.pos != 0 && stage.saved.validator[0] == 0) {
+        // nothing to tell whether the server still has the same image
+        stage_restart(0);
+    }
+    if (stage.pos != 0) {
+        // the server sends all of it, with a 200, if the image has changed
+        snprintf(extra, sizeof(extra), "Range: bytes=%u-\r\nIf-Range: %s\r\n",
+                stage.pos, stage.saved.validator);
+    } else {
+        snprintf(extra, sizeof(extra), "Range: bytes=0-\r\n");
+    }
+    status = ota_http_get(stage_conn, stage.ip, stage.port, (char*)stage.buf, OTA_BUF_SIZE,
+            extra, "%s%d.bin", stage.url, stage.saved.slot);
+    ota_http_validator((const char*)stage.buf, validator, sizeof(validator));
+    if (status == 206) {
+        size = ota_http_range_total((const char*)stage.buf);
+        if (stage.pos != 0 && os_strcmp(validator, stage.saved.validator) != 0) {
+            // a server that ignored If-Range, start over
+            stage_restart(size);
+            stage_conn.stop();
+            return true;
+        }
+    } else if (status == 200) {
+        // no Range support, the whole image is coming
+        const char* clen_pos = ota_http_header((const char*)stage.buf, "Content-Length:");
+        size = clen_pos ? atoi(clen_pos) : -1;
+        if (stage.pos != 0) stage_restart(size);
+    } else {
+        DEBUG("OTA_stage: bad HTTP status %d", status);
+        return false;
+    }
+
+    if (!ota_check_size(stage.saved.slot, size)) {
+        DEBUG("OTA_stage: bad rom size: %d", size);
+        return false;
+    }
+
+    if (stage.saved.size != (uint32_t)size) {
+        if (stage.pos != 0) {
+            // resuming a different image, ask again from the start
+            stage_restart(size);
+            stage_conn.stop();
+            return true;
+        }
+        stage.saved.size = size;
+    }
+    if (stage.pos == 0) {
+        os_memcpy(stage.saved.validator, validator, sizeof(validator));
+    }
+    return true;
+}
+
+static void stage_refill() {
+    uint32_t now = millis();
+    uint32_t elapsed = now - stage.last_refill;
+    if (elapsed > 1000) elapsed = 1000;
+    uint32_t add = stage.rate * elapsed / 1000;
+    if (add == 0) return;
+    stage.last_refill = now;
+    stage.tokens += add;
+    if (stage.tokens > OTA_BUF_SIZE) stage.tokens = OTA_BUF_SIZE;
+}
+
+static void stage_complete() {
+    stage_release();
+    if (!ota_check_image(stage.slot_addr)) {
+        DEBUG("OTA_stage: image checksum mismatch");
+        stage_restart(0);
+        stage_save();
+        stage.state = OTA_STAGE_FAILED;
+        return;
+    }
+    stage.saved.done = stage.saved.size;
+    stage.saved.ready = 1;
+    stage_save();
+    stage.state = OTA_STAGE_READY;
+    DEBUG("OTA_stage: rom %d staged", stage.saved.slot);
+}
+
+bool OTA_stage_begin(IPAddress ip, uint16_t port, const char * url, uint32_t bytes_per_sec) {
+    if (stage.state == OTA_STAGE_RUNNING || stage.state == OTA_STAGE_PAUSED) {
+        DEBUG("OTA_stage: already staging!");
+        return false;
+    }
+
+    rboot_config bootconf = rboot_get_config();
+    uint8_t upgrade_slot = bootconf.current_rom == 0 ? 1 : 0;
+    uint32_t slot_addr = bootconf.roms[upgrade_slot];
+    if (!ota_check_slot(upgrade_slot, slot_addr)) {
+        return false;
+    }
+
+    uint32_t source = (uint32_t)ip;
+    source = ota_crc32(0, (const uint8_t*)&source, sizeof(source));
+    source = ota_crc32(source, (const uint8_t*)&port, sizeof(port));
+    source = ota_crc32(source, (const uint8_t*)url, os_strlen(url));
+
+    stage.ip = ip;
+    stage.port = port;
+    stage.url = url;
+    stage.rate = bytes_per_sec;
+    stage.slot_addr = slot_addr;
+    stage.tokens = 0;
+    stage.last_refill = millis();
+    stage.retry_at = 0;
+    stage.buf = NULL;
+
+    ota_config_sector_read(OTA_STAGE_STATE_OFFSET, &stage.saved, sizeof(ota_stage_state));
+    if (stage.saved.magic == OTA_STAGE_MAGIC && stage.saved.crc == state_crc(&stage.saved)
+            && stage.saved.source == source && stage.saved.slot == upgrade_slot) {
+        if (stage.saved.ready && ota_check_image(slot_addr)) {
+            stage.state = OTA_STAGE_READY;
+            return true;
+        }
+        stage.pos = stage.saved.ready ? 0 : stage.saved.done;
+        DEBUG("OTA_stage: resuming rom %d at 0x%x", upgrade_slot, stage.pos);
+    } else {
+        os_memset(&stage.saved, 0, sizeof(ota_stage_state));
+        stage.saved.magic = OTA_STAGE_MAGIC;
+        stage.saved.source = source;
+        stage.saved.slot = upgrade_slot;
+        stage.pos = 0;
+    }
+    stage.saved.ready = 0;
+    stage.erased_to = stage.pos;
+    stage.state = OTA_STAGE_RUNNING;
+    return true;
+}
+
+uint8_t OTA_stage_loop() {
+    if (stage.state != OTA_STAGE_RUNNING) {
+        return stage.state;
+    }
+
+    if (stage.retry_at) {
+        if ((int32_t)(millis() - stage.retry_at) < 0) {
+            return stage.state;
+        }
+        stage.retry_at = 0;
+    }
+
+    if (!stage_conn.connected() && !stage_conn.available()) {
+        if (!stage_connect()) {
+            stage_retry();
+        }
+        return stage.state;
+    }
+
+    stage_refill();
+    if (stage.tokens < 4) {
+        return stage.state;
+    }
+
+    // erase each sector just before the first write into it, and never
+    // write across a sector boundary in one go
+    uint32_t max_len = SECTOR_SIZE - (stage.pos % SECTOR_SIZE);
+    if (max_len > stage.saved.size - stage.pos) max_len = stage.saved.size - stage.pos;
+    if (max_len > stage.tokens) max_len = stage.tokens;
+
+    if (stage.pos >= stage.erased_to) {
+        if (!ota_erase(stage.slot_addr + stage.pos, SECTOR_SIZE)) {
+            stage_fail();
+            return stage.state;
+        }
+        stage.erased_to = stage.pos + SECTOR_SIZE;
+    }
+
+    int32_t written = ota_copy_to_flash(stage_conn, stage.slot_addr + stage.pos, max_len, stage.buf);
+    if (written < 0 || (written == 0 && !stage_conn.connected())) {
+        stage_retry();
+        return stage.state;
+    }
+    stage.tokens -= written;
+    stage.pos += written;
+
+    if (stage.pos == stage.saved.size) {
+        stage_complete();
+    } else if ((stage.pos & ~(SECTOR_SIZE - 1)) - stage.saved.done >= OTA_STAGE_CHECKPOINT) {
+        stage.saved.done = stage.pos & ~(SECTOR_SIZE - 1);
+        DEBUG("OTA_stage: checkpoint at 0x%x", stage.saved.done);
+        stage_save();
+    }
+    return stage.state;
+}
+
+void OTA_stage_pause(bool pause) {
+    if (pause && stage.state == OTA_STAGE_RUNNING) {
+        // let the server go, it's asked to resume from pos later
+        stage_release();
+        stage.state = OTA_STAGE_PAUSED;
+    } else if (!pause && stage.state == OTA_STAGE_PAUSED) {
+        stage.tokens = 0;
+        stage.last_refill = millis();
+        stage.retry_at = 0;
+        stage.state = OTA_STAGE_RUNNING;
+    }
+}
+
+bool OTA_stage_activate() {
+    if (stage.state != OTA_STAGE_READY) {
+        return false;
+    }
+    uint8_t slot = stage.saved.slot;
+
+    // forget the staged image, so a fallback by the boot loader is not
+    // undone by activating it again
+    os_memset(&stage.saved, 0, sizeof(ota_stage_state));
+    if (!ota_config_sector_write(OTA_STAGE_STATE_OFFSET, &stage.saved, sizeof(ota_stage_state))) {
+        return false;
+    }
+
+    // update current rom slot and reboot
+    return ota_boot_rom(slot);
+}
@@ -34,6 +34,7 @@ extern void ets_printf(char*, ...);
 extern void ets_delay_us(int);
 extern void ets_memset(void*, uint8, uint32);
 extern void ets_memcpy(void*, const void*, uint32);
+extern int ets_memcmp(const void*, const void*, uint32);
 
 // functions we'll call by address
 typedef void stage2a(uint32);
@@ -69,4 +70,27 @@ typedef struct {
 	uint32 len; // length of irom section
 } rom_header_new;
 
+// section index appended to new type roms by tools/romindex.py, the add
+// field of rom_header_new holds its offset from the start of the rom (0
+// for roms without one). Everything is little endian and the index is
+// followed by a crc32 of the first ROM_INDEX_LEN(count) bytes.
+#define ROM_INDEX_MAGIC 0x58444972 // "rIDX"
+#define ROM_INDEX_MAX_SECTIONS 16
+#define ROM_INDEX_LEN(count) ((uint32)&((rom_index*)0)->sections[count])
+
+typedef struct {
+	uint32 offset; // of the section data, from the start of the rom
+	section_header section;
+} rom_index_section;
+
+typedef struct {
+	uint32 magic;
+	uint32 length; // of the rom in front of the index
+	uint32 digest; // crc32 of the rom in front of the index
+	rom_header header; // copy of the iram rom header
+	uint32 chksum; // the rom's xor checksum, low byte
+	rom_index_section sections[ROM_INDEX_MAX_SECTIONS];
+	uint32 crc; // room for the crc32 behind the last section
+} rom_index;
+
 #endif
\ No newline at end of file
@@ -7,6 +7,93 @@
 
 #include "rboot-private.h"
 #include "rboot-hex2a.h"
+#include "flash_layout.h"
+
+#ifdef BOOT_ROM_INDEX
+// crc32 as in zlib, bitwise to keep the table out of the boot loader
+static uint32 calc_crc32(uint8 *data, uint32 len) {
+	uint32 crc = 0xffffffff;
+	uint32 bit;
+	while (len > 0) {
+		crc ^= *data;
+		for (bit = 0; bit < 8; bit++) {
+			crc = (crc >> 1) ^ (0xedb88320 & -(crc & 1));
+		}
+		data++;
+		len--;
+	}
+	return ~crc;
+}
+
+// read the section index at offset in the rom at start, and check
+// it's intact
+static uint8 read_index(uint32 start, uint32 offset, rom_index *index) {
+	uint32 len;
+	
+	if ((offset & 0x0f) != 0 || SPIRead(start + offset, index, sizeof(rom_index)) != 0) {
+		return FALSE;
+	}
+	if (index->magic != ROM_INDEX_MAGIC || index->length != offset || index->header.magic != ROM_MAGIC
+		|| index->header.count == 0 || index->header.count > ROM_INDEX_MAX_SECTIONS) {
+		return FALSE;
+	}
+	len = ROM_INDEX_LEN(index->header.count);
+	return calc_crc32((uint8*)index, len) == *(uint32*)((uint8*)index + len);
+}
+
+// same checks as the walk in check_image, but each section is read
+// together with its header in BUFFER_SIZE chunks, which saves the separate
+// read per header and the one for the checksum byte
+static uint8 check_index(rom_index *index, uint32 start, uint32 readpos, uint8 *buffer) {
+	uint8 chksum = CHKSUM_INIT;
+	uint8 sectnum;
+	uint32 loop;
+	uint32 skip;
+	uint32 readlen;
+	uint32 end;
+	rom_index_section *sect;
+	
+	for (sectnum = 0; sectnum < index->header.count; sectnum++) {
+		sect = &index->sections[sectnum];
+		// headers in front of the data, the first section also has the rom header
+		skip = sizeof(section_header);
+		if (sectnum == 0) skip += sizeof(rom_header);
+		if (sect->offset != readpos - start + skip
+			|| sect->section.length > index->length - sect->offset) {
+			return FALSE;
+		}
+		end = start + sect->offset + sect->section.length;
+		
+		do {
+			readlen = end - readpos;
+			if (readlen > BUFFER_SIZE) readlen = BUFFER_SIZE;
+			if (SPIRead(readpos, buffer, readlen) != 0) {
+				return FALSE;
+			}
+			// the headers must say what the index says, stage2a goes by them
+			if (skip != 0) {
+				if (sectnum == 0 && ets_memcmp(buffer, &index->header, sizeof(rom_header)) != 0) {
+					return FALSE;
+				}
+				if (ets_memcmp(buffer + skip - sizeof(section_header), &sect->section, sizeof(section_header)) != 0) {
+					return FALSE;
+				}
+			}
+			for (loop = skip; loop < readlen; loop++) {
+				chksum ^= buffer[loop];
+			}
+			skip = 0;
+			readpos += readlen;
+		} while (readpos < end);
+	}
+	
+	// the checksum byte at the next 16 byte boundary is in the index
+	if ((readpos | 0x0f) - start >= index->length) {
+		return FALSE;
+	}
+	return chksum == (uint8)index->chksum;
+}
+#endif
 
 static uint32 check_image(uint32 readpos) {
 	
@@ -20,6 +107,9 @@ static uint32 check_image(uint32 readpos) {
 	
 	rom_header_new *header = (rom_header_new*)buffer;
 	section_header *section = (section_header*)buffer;
+#ifdef BOOT_ROM_INDEX
+	rom_index index;
+#endif
 	
 	if (readpos == 0 || readpos == 0xffffffff) {
 		return 0;
@@ -36,6 +126,12 @@ static uint32 check_image(uint32 readpos) {
 		romaddr = readpos;
 	} else if (header->magic == ROM_MAGIC_NEW1 && header->count == ROM_MAGIC_NEW2) {
 		// new type, has extra header and irom segment to skip over
+#ifdef BOOT_ROM_INDEX
+		if (header->add != 0 && read_index(readpos, header->add, &index)) {
+			romaddr = readpos + header->len + sizeof(rom_header_new);
+			return check_index(&index, readpos, romaddr, buffer) ? romaddr : 0;
+		}
+#endif
 		readpos += (header->len + sizeof(rom_header_new));
 		romaddr = readpos;
 		// read the normal header that follows
@@ -130,72 +226,55 @@ static uint8 calc_chksum(uint8 *start, uint8 *end) {
 }
 #endif
 
-// prevent this function being placed inline with main
-// to keep main's stack size as small as possible
-// don't mark as static or it'll be optimised out when
-// using the assembler stub
-uint32 NOINLINE find_image() {
-	
-	uint8 flag;
-	uint32 runAddr;
-	uint32 flashsize;
-	int32 romToBoot;
-	uint8 gpio_boot = FALSE;
-	uint8 updateConfig = TRUE;
-	uint8 buffer[SECTOR_SIZE];
-
-	rboot_config *romconf = (rboot_config*)buffer;
-	rom_header *header = (rom_header*)buffer;
-	
-	// delay to slow boot (help see messages when debugging)
-	//ets_delay_us(2000000);
-	
-	ets_printf("\r\nrBoot v1.2.0 - richardaburton@gmail.com\r\n");
-	
-	// read rom header
-	SPIRead(0, header, sizeof(rom_header));
-	
-	// print and get flash size
-	ets_printf("Flash Size:   ");
-	flag = header->flags2 >> 4;
+static uint32 get_flash_size(uint8 flags2) {
+	uint8 flag = flags2 >> 4;
 	if (flag == 0) {
-		ets_printf("4 Mbit\r\n");
-		flashsize = 0x80000;
+		return 0x80000;
 	} else if (flag == 1) {
-		ets_printf("2 Mbit\r\n");
-		flashsize = 0x40000;
+		return 0x40000;
 	} else if (flag == 2) {
-		ets_printf("8 Mbit\r\n");
-		flashsize = 0x100000;
+		return 0x100000;
 	} else if (flag == 3) {
-		ets_printf("16 Mbit\r\n");
 #ifdef BOOT_BIG_FLASH
-		flashsize = 0x200000;
+		return 0x200000;
 #else
-		flashsize = 0x100000; // limit to 8Mbit
+		return 0x100000; // limit to 8Mbit
 #endif
 	} else if (flag == 4) {
-		ets_printf("32 Mbit\r\n");
 #ifdef BOOT_BIG_FLASH
-		flashsize = 0x400000;
+		return 0x400000;
 #else
-		flashsize = 0x100000; // limit to 8Mbit
+		return 0x100000; // limit to 8Mbit
 #endif
-	} else {
-		ets_printf("unknown\r\n");
-		// assume at least 4mbit
-		flashsize = 0x80000;
 	}
+	// assume at least 4mbit
+	return 0x80000;
+}
+
+static void print_boot_info(uint8 flags1, uint8 flags2) {
+	uint8 flag;
+
+	ets_printf("\r\nrBoot v1.2.0 - richardaburton@gmail.com\r\n");
+
+	// print flash size
+	ets_printf("Flash Size:   ");
+	flag = flags2 >> 4;
+	if (flag == 0) ets_printf("4 Mbit\r\n");
+	else if (flag == 1) ets_printf("2 Mbit\r\n");
+	else if (flag == 2) ets_printf("8 Mbit\r\n");
+	else if (flag == 3) ets_printf("16 Mbit\r\n");
+	else if (flag == 4) ets_printf("32 Mbit\r\n");
+	else ets_printf("unknown\r\n");
 	
 	// print spi mode
 	ets_printf("Flash Mode:   ");
-	if (header->flags1 == 0) {
+	if (flags1 == 0) {
 		ets_printf("QIO\r\n");
-	} else if (header->flags1 == 1) {
+	} else if (flags1 == 1) {
 		ets_printf("QOUT\r\n");
-	} else if (header->flags1 == 2) {
+	} else if (flags1 == 2) {
 		ets_printf("DIO\r\n");
-	} else if (header->flags1 == 3) {
+	} else if (flags1 == 3) {
 		ets_printf("DOUT\r\n");
 	} else {
 		ets_printf("unknown\r\n");
@@ -203,7 +282,7 @@ uint32 NOINLINE find_image() {
 	
 	// print spi speed
 	ets_printf("Flash Speed:  ");
-	flag = header->flags2 & 0x0f;
+	flag = flags2 & 0x0f;
 	if (flag == 0) ets_printf("40 MHz\r\n");
 	else if (flag == 1) ets_printf("26.7 MHz\r\n");
 	else if (flag == 2) ets_printf("20 MHz\r\n");
@@ -217,6 +296,83 @@ uint32 NOINLINE find_image() {
 #ifdef BOOT_CONFIG_CHKSUM
 	ets_printf("rBoot Option: Config chksum\r\n");
 #endif
+}
+
+#ifdef BOOT_QUIET
+
+// informational messages only go to the rtc boot log
+#define BOOT_INFO(...)
+
+// append a record to the rtc boot log, see rboot.h
+static void boot_log(uint32 type, uint32 value) {
+	volatile uint32 *rtc = (volatile uint32*)BOOT_LOG_RTC_ADDR;
+	uint32 next = (rtc[0] >> 8) & 0xff;
+	uint32 count = rtc[0] & 0xff;
+
+	// rtc memory is random after power up
+	if ((rtc[0] >> 16) != BOOT_LOG_MAGIC || next >= BOOT_LOG_RECORDS || count > BOOT_LOG_RECORDS) {
+		next = 0;
+		count = 0;
+		rtc[1] = 0;
+	}
+	if (type == BOOT_LOG_START) {
+		value = ++rtc[1];
+	}
+
+	rtc[2 + next] = BOOT_LOG_REC(type, value);
+	if (++next == BOOT_LOG_RECORDS) next = 0;
+	if (count < BOOT_LOG_RECORDS) count++;
+	rtc[0] = (BOOT_LOG_MAGIC << 16) | (next << 8) | count;
+}
+
+#else
+
+#define BOOT_INFO(...) ets_printf(__VA_ARGS__)
+#define boot_log(type, value)
+
+#endif
+
+// prevent this function being placed inline with main
+// to keep main's stack size as small as possible
+// don't mark as static or it'll be optimised out when
+// using the assembler stub
+uint32 NOINLINE find_image() {
+	
+	uint8 flags1;
+	uint8 flags2;
+	uint32 runAddr;
+	uint32 flashsize;
+	int32 romToBoot;
+	uint8 gpio_boot = FALSE;
+	uint8 updateConfig = TRUE;
+	uint8 buffer[SECTOR_SIZE];
+
+	rboot_config *romconf = (rboot_config*)buffer;
+	rom_header *header = (rom_header*)buffer;
+	
+	// delay to slow boot (help see messages when debugging)
+	//ets_delay_us(2000000);
+	
+	// read rom header
+	SPIRead(0, header, sizeof(rom_header));
+	flags1 = header->flags1;
+	flags2 = header->flags2;
+	flashsize = get_flash_size(flags2);
+
+#ifdef BOOT_QUIET
+	boot_log(BOOT_LOG_START, 0);
+	boot_log(BOOT_LOG_FLASH, (flags1 << 8) | flags2);
+	boot_log(BOOT_LOG_OPTIONS, 0
+#ifdef BOOT_BIG_FLASH
+		| BOOT_LOG_OPT_BIG_FLASH
+#endif
+#ifdef BOOT_CONFIG_CHKSUM
+		| BOOT_LOG_OPT_CONFIG_CHKSUM
+#endif
+		);
+#else
+	print_boot_info(flags1, flags2);
+#endif
 	
 	// read boot config
 	SPIRead(BOOT_CONFIG_SECTOR * SECTOR_SIZE, buffer, SECTOR_SIZE);
@@ -226,19 +382,18 @@ uint32 NOINLINE find_image() {
 		|| romconf->chksum != calc_chksum((uint8*)romconf, (uint8*)&romconf->chksum)
 #endif
 		) {
-		// create a default config for a standard 2 rom setup
-		ets_printf("Writing default boot config.\r\n");
+		// create a default config from the flash layout
+		BOOT_INFO("Writing default boot config.\r\n");
+		boot_log(BOOT_LOG_DEFAULT_CONFIG, 0);
+		if (LAYOUT_ROM_END(1) > flashsize) {
+			ets_printf("Flash too small for the rom layout!\r\n");
+		}
 		ets_memset(romconf, 0x00, sizeof(rboot_config));
-#ifndef BOOT_BIG_FLASH
-		if (flashsize > 0x100000) flashsize = 0x100000;
-#else
-		if (flashsize > 0x200000) flashsize = 0x200000;
-#endif
 		romconf->magic = BOOT_CONFIG_MAGIC;
 		romconf->version = BOOT_CONFIG_VERSION;
-		romconf->count = 2;
-		romconf->roms[0] = SECTOR_SIZE * 2;
-		romconf->roms[1] = (flashsize / 2) + (SECTOR_SIZE * 2);
+		romconf->count = LAYOUT_ROM_COUNT;
+		romconf->roms[0] = LAYOUT_ROM0_ADDR;
+		romconf->roms[1] = LAYOUT_ROM1_ADDR;
 #ifdef BOOT_CONFIG_CHKSUM
 		romconf->chksum = calc_chksum((uint8*)romconf, (uint8*)&romconf->chksum);
 #endif
@@ -249,12 +404,14 @@ uint32 NOINLINE find_image() {
 	
 	// if gpio mode enabled check status of the gpio
 	if ((romconf->mode & MODE_GPIO_ROM) && (get_gpio16() == 0)) {
-		ets_printf("Booting GPIO-selected.\r\n");
+		BOOT_INFO("Booting GPIO-selected.\r\n");
+		boot_log(BOOT_LOG_GPIO_BOOT, romconf->gpio_rom);
 		romToBoot = romconf->gpio_rom;
 		gpio_boot = TRUE;
 	} else if (romconf->current_rom >= romconf->count) {
 		// if invalid rom selected try rom 0
 		ets_printf("Invalid rom selected, defaulting.\r\n");
+		boot_log(BOOT_LOG_INVALID_ROM, romconf->current_rom);
 		romToBoot = 0;
 		romconf->current_rom = 0;
 		updateConfig = TRUE;
@@ -263,14 +420,20 @@ uint32 NOINLINE find_image() {
 		romToBoot = romconf->current_rom;
 	}
 
-	ets_printf("ROM0: 0x%08X, ROM1: 0x%08X\r\n", romconf->roms[0], romconf->roms[1]);
+	BOOT_INFO("ROM0: 0x%08X, ROM1: 0x%08X\r\n", romconf->roms[0], romconf->roms[1]);
+	boot_log(BOOT_LOG_ROM_ADDR, (0 << 16) | (romconf->roms[0] >> 12));
+	boot_log(BOOT_LOG_ROM_ADDR, (1 << 16) | (romconf->roms[1] >> 12));
 	// try to find a good rom
 	do {
 		runAddr = check_image(romconf->roms[romToBoot]);
 		if (runAddr == 0) {
 			ets_printf("Rom %d is bad.\r\n", romToBoot);
+			boot_log(BOOT_LOG_ROM_BAD, romToBoot);
 			if (gpio_boot) {
 				// don't switch to backup for gpio-selected rom
+#ifdef BOOT_QUIET
+				print_boot_info(flags1, flags2);
+#endif
 				ets_printf("GPIO boot failed.\r\n");
 				return 0;
 			} else {
@@ -281,7 +444,11 @@ uint32 NOINLINE find_image() {
 				if (romToBoot < 0) romToBoot = romconf->count - 1;
 				if (romToBoot == romconf->current_rom) {
 					// tried them all and all are bad!
+#ifdef BOOT_QUIET
+					print_boot_info(flags1, flags2);
+#endif
 					ets_printf("No good rom available.\r\n");
+					boot_log(BOOT_LOG_NO_ROM, 0);
 					return 0;
 				}
 			}
@@ -298,7 +465,8 @@ uint32 NOINLINE find_image() {
 		SPIWrite(BOOT_CONFIG_SECTOR * SECTOR_SIZE, buffer, SECTOR_SIZE);
 	}
 	
-	ets_printf("Booting rom %d.\r\n", romToBoot);
+	BOOT_INFO("Booting rom %d.\r\n", romToBoot);
+	boot_log(BOOT_LOG_BOOTING, romToBoot);
 	// copy the loader to top of iram
 	ets_memcpy((void*)_text_addr, _text_data, _text_len);
 	// return address to load from
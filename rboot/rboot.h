@@ -15,9 +15,17 @@
 // uncomment to have a checksum on the boot config
 #define BOOT_CONFIG_CHKSUM
 
+// uncomment to check roms by the section index tools/romindex.py appends,
+// in one pass of large reads, roms without one are still walked
+#define BOOT_ROM_INDEX
+
 // uncomment to enable big flash support (>1MB)
 //#define BOOT_BIG_FLASH
 
+// uncomment to keep the boot messages off the serial port, they are
+// logged to rtc memory instead (see boot log below), errors still print
+//#define BOOT_QUIET
+
 // increase if required
 #define MAX_ROMS 4
 
@@ -54,4 +62,35 @@ typedef struct {
 #endif
 } rboot_config;
 
+// boot log, a ring of records in rtc user memory kept across resets
+// (not power cycles) when built with BOOT_QUIET. A header word of
+// magic << 16 | next << 8 | count, a boot counter, then the records,
+// each type << 24 | 24 bit value. It takes rtc user blocks 176..191, the
+// last 64 bytes of rtc memory, so applications using ESP.rtcUserMemory*
+// or system_rtc_mem_* must keep clear of them.
+#define BOOT_LOG_RTC_BLOCK 176 // rtc memory is addressed in 4 byte blocks
+// block n of system_rtc_mem_read/write is at 0x60001100 + n * 4, the 768
+// bytes end at 0x60001400
+#define BOOT_LOG_RTC_ADDR (0x60001100 + BOOT_LOG_RTC_BLOCK * 4)
+#define BOOT_LOG_MAGIC 0xb10c
+#define BOOT_LOG_RECORDS 14
+
+#define BOOT_LOG_REC(type, value) (((uint32)(type) << 24) | ((value) & 0xffffff))
+#define BOOT_LOG_TYPE(rec) ((rec) >> 24)
+#define BOOT_LOG_VALUE(rec) ((rec) & 0xffffff)
+
+#define BOOT_LOG_START 0x01          // boot counter
+#define BOOT_LOG_FLASH 0x02          // rom header flags1 << 8 | flags2
+#define BOOT_LOG_OPTIONS 0x03        // BOOT_LOG_OPT_* bits
+#define BOOT_LOG_DEFAULT_CONFIG 0x04 // default boot config written
+#define BOOT_LOG_GPIO_BOOT 0x05      // rom selected by gpio
+#define BOOT_LOG_INVALID_ROM 0x06    // bad current_rom, defaulted
+#define BOOT_LOG_ROM_ADDR 0x07       // rom << 16 | flash sector
+#define BOOT_LOG_ROM_BAD 0x08        // rom
+#define BOOT_LOG_NO_ROM 0x09         // nothing bootable
+#define BOOT_LOG_BOOTING 0x0a        // rom
+
+#define BOOT_LOG_OPT_BIG_FLASH 0x01
+#define BOOT_LOG_OPT_CONFIG_CHKSUM 0x02
+
 #endif
\ No newline at end of file
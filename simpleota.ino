@@ -12,6 +12,15 @@ extern "C" {
 #define BUTTON_PIN      5
 #endif
 
+#ifdef MANIFEST_URL
+#ifndef FW_VERSION
+#error "MANIFEST_URL needs FW_VERSION, which the Makefile defines"
+#endif
+#ifndef MANIFEST_POLL
+#define MANIFEST_POLL   60000
+#endif
+#endif
+
 //can make all/some static and change them when needed
 const IPAddress ota_server(UPDATE_HOST);
 const uint16_t ota_port = UPDATE_PORT;
@@ -29,18 +38,58 @@ void setup() {
     Serial.println("\r\n\r\nArduino with rboot sample");
     Serial.print("running rom ");
     Serial.println(rboot_get_current_rom());
+
+    // boot messages of a quiet rboot, see BOOT_QUIET in rboot/rboot.h
+    uint32_t boot_log[BOOT_LOG_RECORDS];
+    char line[64];
+    uint8_t records = rboot_get_boot_log(boot_log, BOOT_LOG_RECORDS);
+    for (uint8_t i = 0; i < records; i++) {
+        rboot_format_boot_log(boot_log[i], line, sizeof(line));
+        Serial.println(line);
+    }
+
     WiFi.begin(SSID, PASS);
     if(WiFi.waitForConnectResult() == WL_CONNECTED){
       Serial.printf("Connected to %s\n", SSID);
     }
+#ifdef PUSH_PORT
+    OTA_push_begin(PUSH_PORT, "/update");
+#endif
+#ifdef STAGE_RATE
+    OTA_stage_begin(ota_server, ota_port, ota_url, STAGE_RATE);
+#endif
     attachInterrupt(BUTTON_PIN, on_button, FALLING);
 }
 
 void loop() {
+#ifdef PUSH_PORT
+    OTA_push_loop();
+#endif
+#ifdef STAGE_RATE
+    // the button picks the moment to switch to the staged rom
+    uint8_t stage = OTA_stage_loop();
+    if (start_update) {
+        start_update = false;
+        if (stage == OTA_STAGE_READY) {
+            OTA_stage_activate();
+        }
+    }
+#elif defined(MANIFEST_URL)
+    // poll the manifest, the button checks right away
+    static uint32_t last_check = 0;
+    if (start_update || millis() - last_check > MANIFEST_POLL) {
+        start_update = false;
+        last_check = millis();
+        if (OTA_check_update(ota_server, ota_port, MANIFEST_URL, FW_VERSION) == OTA_CHECK_ERROR) {
+            Serial.println("update check failed");
+        }
+    }
+#else
     if (start_update) {
         start_update = false;
         Serial.printf("OTA_update: http://" IPSTR ":%d%s%u.bin\r\n", IP2STR((uint32_t)ota_server), ota_port, ota_url, !rboot_get_current_rom());
         OTA_update(ota_server, ota_port, ota_url);
     }
+#endif
     delay(50);
 }
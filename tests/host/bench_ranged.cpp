@@ -0,0 +1,55 @@
+// Fetches a rom from a real server with OTA_update() or OTA_update_ranged(),
+// run by bench_ranged.py.
+//
+//   build/bench_ranged PORT STREAMS ROM
+//
+// STREAMS 0 is OTA_update(). Prints the time taken, fails unless the slot
+// ends up holding ROM and the device would reboot into it.
+
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+
+#include "rBootOTA.h"
+#include "flash_layout.h"
+#include "fakes.h"
+
+int main(int argc, char** argv) {
+    if (argc != 4) {
+        fprintf(stderr, "usage: %s PORT STREAMS ROM\n", argv[0]);
+        return 2;
+    }
+    int port = atoi(argv[1]);
+    int streams = atoi(argv[2]);
+
+    static uint8_t rom[FAKE_FLASH_SIZE];
+    FILE* f = fopen(argv[3], "rb");
+    if (!f) {
+        perror(argv[3]);
+        return 2;
+    }
+    size_t rom_size = fread(rom, 1, sizeof(rom), f);
+    fclose(f);
+
+    memset(fake_flash, 0xff, sizeof(fake_flash));
+    rboot_config conf;
+    memset(&conf, 0, sizeof(conf));
+    conf.magic = BOOT_CONFIG_MAGIC;
+    conf.version = BOOT_CONFIG_VERSION;
+    conf.count = 2;
+    conf.roms[0] = LAYOUT_ROM0_ADDR;
+    conf.roms[1] = LAYOUT_ROM1_ADDR;
+    rboot_set_config(&conf);
+
+    unsigned long start = millis();
+    if (streams == 0) {
+        OTA_update(IPAddress(127, 0, 0, 1), port, "/rom");
+    } else {
+        OTA_update_ranged(IPAddress(127, 0, 0, 1), port, "/rom", streams);
+    }
+    unsigned long took = millis() - start;
+
+    bool ok = fake_restarted && rboot_get_current_rom() == 1
+        && memcmp(fake_flash + LAYOUT_ROM1_ADDR, rom, rom_size) == 0;
+    printf("%lu ms %s\n", took, ok ? "ok" : "FAILED");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,98 @@
+#!/usr/bin/env python3
+#
+# Times OTA_update() against OTA_update_ranged() fetching the same rom from
+# a server on the loopback interface, see bench_ranged.cpp.
+#
+#   tests/host/bench_ranged.py [--window 2920] [--rtt 0.03]
+#
+# The server sends each response in --window sized chunks with --rtt
+# seconds between them. That's what a single connection to the device looks
+# like: lwIP's receive window is two segments, so only that much is in
+# flight per round trip however fast the link is. Fails unless the ranged
+# download is quicker than the single stream.
+
+import argparse
+import http.server
+import os
+import re
+import subprocess
+import sys
+import tempfile
+import threading
+import time
+
+from romgen import make_rom
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+BENCH = os.path.join(HERE, 'build', 'bench_ranged')
+
+
+def make_handler(rom, window, rtt):
+    class Handler(http.server.BaseHTTPRequestHandler):
+        def do_GET(self):
+            start, end = 0, len(rom) - 1
+            m = re.match(r'bytes=(\d+)-(\d*)$', self.headers.get('Range', ''))
+            if m:
+                start = int(m.group(1))
+                if m.group(2):
+                    end = min(int(m.group(2)), end)
+                self.send_response(206)
+                self.send_header('Content-Range', 'bytes %d-%d/%d' % (start, end, len(rom)))
+            else:
+                self.send_response(200)
+            self.send_header('Content-Length', str(end + 1 - start))
+            self.end_headers()
+            self.wfile.flush()
+            for pos in range(start, end + 1, window):
+                time.sleep(rtt)
+                self.wfile.write(rom[pos:min(pos + window, end + 1)])
+                self.wfile.flush()
+
+        def log_message(self, *args):
+            pass
+
+    return Handler
+
+
+def main():
+    ap = argparse.ArgumentParser(description='single stream vs ranged OTA download')
+    ap.add_argument('--window', type=int, default=2920,
+                    help='bytes per round trip and connection')
+    ap.add_argument('--rtt', type=float, default=0.03, help='seconds')
+    ap.add_argument('--size', type=int, default=160 * 1024, help='irom bytes')
+    args = ap.parse_args()
+
+    server = http.server.ThreadingHTTPServer(('127.0.0.1', 0), None)
+    server.daemon_threads = True
+
+    with tempfile.TemporaryDirectory() as tmp:
+        path = os.path.join(tmp, 'rom1.bin')
+        rom = make_rom(path, args.size)
+        server.RequestHandlerClass = make_handler(rom, args.window, args.rtt)
+        threading.Thread(target=server.serve_forever, daemon=True).start()
+
+        print('%d byte rom, %d bytes per %d ms round trip' % (
+            len(rom), args.window, args.rtt * 1000))
+        times = {}
+        failed = False
+        for streams in range(4):
+            res = subprocess.run([BENCH, str(server.server_address[1]), str(streams), path],
+                                 stdout=subprocess.PIPE, universal_newlines=True)
+            name = 'OTA_update()' if streams == 0 else 'OTA_update_ranged(%d)' % streams
+            print('%-22s %s' % (name, res.stdout.strip()))
+            if res.returncode:
+                failed = True
+            else:
+                times[streams] = int(res.stdout.split()[0])
+        server.shutdown()
+
+    if failed:
+        return 1
+    if min(times[2], times[3]) >= times[0]:
+        print('ranged download is not faster')
+        return 1
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
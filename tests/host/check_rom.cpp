@@ -0,0 +1,27 @@
+// Runs ota_check_image() on a rom file, for test_romindex.py.
+//
+//   build/check_rom ROM
+//
+// Exits 0 if the image passes, 1 if it's rejected.
+
+#include <Arduino.h>
+
+#include "rBootOTA-private.h"
+#include "flash_layout.h"
+#include "fakes.h"
+
+int main(int argc, char** argv) {
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s ROM\n", argv[0]);
+        return 2;
+    }
+    FILE* f = fopen(argv[1], "rb");
+    if (!f) {
+        perror(argv[1]);
+        return 2;
+    }
+    memset(fake_flash, 0xff, sizeof(fake_flash));
+    fread(fake_flash + LAYOUT_ROM1_ADDR, 1, LAYOUT_ROM1_SIZE, f);
+    fclose(f);
+    return ota_check_image(LAYOUT_ROM1_ADDR) ? 0 : 1;
+}
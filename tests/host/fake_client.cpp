@@ -0,0 +1,83 @@
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+
+#include "fakes.h"
+
+// WiFiClient serving a canned response, and a clock to go with it
+
+#define FAKE_MAX_RESPONSES 4
+
+static struct {
+    const uint8_t* data;
+    size_t len;
+} responses[FAKE_MAX_RESPONSES];
+static int queued, next;
+
+static const uint8_t* served;
+static size_t served_len, served_pos;
+static unsigned long now;
+
+char fake_request[512];
+static size_t request_len;
+
+void fake_serve(const uint8_t* response, size_t len) {
+    queued = next = 0;
+    fake_queue(response, len);
+}
+
+void fake_queue(const uint8_t* response, size_t len) {
+    if (queued < FAKE_MAX_RESPONSES) {
+        responses[queued].data = response;
+        responses[queued].len = len;
+        queued++;
+    }
+}
+
+// time moves on a little with every look at it, so timeouts still work
+unsigned long millis() { return now++; }
+void delay(unsigned long ms) { now += ms; }
+
+// one queued response per connection, the last one for all that follow
+int WiFiClient::connect(IPAddress ip, uint16_t port) {
+    served = responses[next].data;
+    served_len = served_pos = responses[next].len;
+    if (!served) return 0;
+    if (next < queued - 1) next++;
+    served_pos = 0;
+    request_len = 0;
+    fake_request[0] = 0;
+    return 1;
+}
+
+uint8_t WiFiClient::connected() { return served_pos < served_len; }
+void WiFiClient::stop() { served_pos = served_len; }
+WiFiClient::operator bool() { return true; }
+int WiFiClient::available() { return served_len - served_pos; }
+
+int WiFiClient::read() {
+    return served_pos < served_len ? served[served_pos++] : -1;
+}
+
+int WiFiClient::read(uint8_t* buf, size_t size) {
+    return readBytes(buf, size);
+}
+
+size_t WiFiClient::readBytes(uint8_t* buf, size_t size) {
+    if (size > served_len - served_pos) size = served_len - served_pos;
+    memcpy(buf, served + served_pos, size);
+    served_pos += size;
+    return size;
+}
+
+size_t WiFiClient::write(const uint8_t* buf, size_t size) {
+    size_t room = sizeof(fake_request) - 1 - request_len;
+    size_t n = size < room ? size : room;
+    memcpy(fake_request + request_len, buf, n);
+    request_len += n;
+    fake_request[request_len] = 0;
+    return size;
+}
+
+size_t WiFiClient::print(const char* s) {
+    return write((const uint8_t*)s, strlen(s));
+}
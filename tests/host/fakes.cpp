@@ -0,0 +1,114 @@
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+#include <user_interface.h>
+#include <flash_utils.h>
+#include <mem.h>
+
+#include "fakes.h"
+
+#define FAKE_SECTOR_SIZE 0x1000
+#define FAKE_BLOCK_SIZE 0x10000
+
+uint8_t fake_flash[FAKE_FLASH_SIZE];
+int fake_sector_erases = 0;
+int fake_block_erases = 0;
+uint32_t fake_erase_ms = 0;
+bool fake_malloc_fails = false;
+int fake_malloc_calls = 0;
+bool fake_restarted = false;
+
+static uint8_t rtc[768];
+
+void* host_malloc(size_t size) {
+    fake_malloc_calls++;
+    return fake_malloc_fails ? NULL : malloc(size);
+}
+
+void host_free(void* ptr) {
+    free(ptr);
+}
+
+void yield() {}
+void noInterrupts() {}
+void interrupts() {}
+
+EspClass ESP;
+void EspClass::restart() { fake_restarted = true; }
+
+WiFiClass WiFi;
+uint32_t fake_local_ip = IPAddress(192, 168, 42, 10);
+IPAddress WiFiClass::localIP() { return IPAddress(fake_local_ip); }
+
+static bool in_flash(uint32_t addr, size_t len) {
+    return addr <= FAKE_FLASH_SIZE && len <= FAKE_FLASH_SIZE - addr;
+}
+
+// like nor flash, writes can only clear bits
+static int flash_write(uint32_t addr, const uint8_t* data, size_t len) {
+    if (!in_flash(addr, len)) return 1;
+    for (size_t i = 0; i < len; i++) {
+        fake_flash[addr + i] &= data[i];
+    }
+    return 0;
+}
+
+extern "C" {
+
+int SPIRead(uint32_t addr, void* dest, size_t size) {
+    if (!in_flash(addr, size)) return 1;
+    memcpy(dest, fake_flash + addr, size);
+    return 0;
+}
+
+int SPIWrite(uint32_t addr, void* src, size_t size) {
+    return flash_write(addr, (const uint8_t*)src, size);
+}
+
+int SPIEraseSector(uint32_t sector) {
+    if (!in_flash(sector * FAKE_SECTOR_SIZE, FAKE_SECTOR_SIZE)) return 1;
+    memset(fake_flash + sector * FAKE_SECTOR_SIZE, 0xff, FAKE_SECTOR_SIZE);
+    fake_sector_erases++;
+    fake_erase_ms += FAKE_SECTOR_ERASE_MS;
+    return 0;
+}
+
+int SPIEraseBlock(uint32_t block) {
+    if (!in_flash(block * FAKE_BLOCK_SIZE, FAKE_BLOCK_SIZE)) return 1;
+    memset(fake_flash + block * FAKE_BLOCK_SIZE, 0xff, FAKE_BLOCK_SIZE);
+    fake_block_erases++;
+    fake_erase_ms += FAKE_BLOCK_ERASE_MS;
+    return 0;
+}
+
+int SPIEraseAreaEx(const uint32_t start, const uint32_t size) {
+    for (uint32_t addr = start; addr < start + size; addr += FAKE_SECTOR_SIZE) {
+        if (SPIEraseSector(addr / FAKE_SECTOR_SIZE)) return 1;
+    }
+    return 0;
+}
+
+int spi_flash_read(uint32 addr, uint32* data, uint32 len) {
+    return SPIRead(addr, data, len);
+}
+
+int spi_flash_write(uint32 addr, uint32* data, uint32 len) {
+    return flash_write(addr, (const uint8_t*)data, len);
+}
+
+int spi_flash_erase_sector(uint16 sector) {
+    return SPIEraseSector(sector);
+}
+
+bool system_rtc_mem_read(uint8 block, void* data, uint16 len) {
+    if (block < 64 || block * 4u + len > sizeof(rtc)) return false;
+    memcpy(data, rtc + block * 4, len);
+    return true;
+}
+
+bool system_rtc_mem_write(uint8 block, const void* data, uint16 len) {
+    if (block < 64 || block * 4u + len > sizeof(rtc)) return false;
+    memcpy(rtc + block * 4, data, len);
+    return true;
+}
+
+}
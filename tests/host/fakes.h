@@ -0,0 +1,42 @@
+#pragma once
+
+// Host side stand-ins for the flash, heap, network and rtc memory the OTA
+// code uses, see stubs/ for the matching headers.
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define FAKE_FLASH_SIZE 0x400000
+
+extern uint8_t fake_flash[FAKE_FLASH_SIZE];
+
+// erase commands issued, and what they would have cost on a typical SPI
+// NOR part (W25Q32 datasheet typical times)
+#define FAKE_SECTOR_ERASE_MS    45
+#define FAKE_BLOCK_ERASE_MS     150
+
+extern int fake_sector_erases;
+extern int fake_block_erases;
+extern uint32_t fake_erase_ms;
+
+// os_malloc fails while this is set, every call is counted either way
+extern bool fake_malloc_fails;
+extern int fake_malloc_calls;
+
+// what the next WiFiClient::connect() gets served, fake_client.cpp only.
+// fake_queue() adds a response for the connection after, the last one
+// queued is served to all that follow.
+void fake_serve(const uint8_t* response, size_t len);
+void fake_queue(const uint8_t* response, size_t len);
+
+// what was sent on the latest connection
+extern char fake_request[512];
+
+// what WiFi.localIP() says, socket_udp.cpp binds to it
+extern uint32_t fake_local_ip;
+
+// share of the udp packets socket_udp.cpp drops on receive
+extern float fake_udp_loss;
+
+// set by ESP.restart()
+extern bool fake_restarted;
@@ -0,0 +1,75 @@
+#!/usr/bin/env python3
+#
+# Runs tools/ota_mcast_send.py with --loss against several host builds of
+# OTA_multicast_update() (build/mcast_receiver) on the loopback interface
+# and checks each ends up booting its slot's image.
+#
+#   tests/host/mcast_loopback.py [--receivers 4] [--loss 0.2]
+#
+# Each receiver has its own 127.0.0.x address for the unicast NAKs and
+# repairs, and drops its own share of packets on top of the sender's, so
+# they all miss different blocks. The last one only starts once the
+# multicast round is over and gets everything through NAKs. The session
+# id is 0, which is as valid as any other.
+
+import argparse
+import os
+import subprocess
+import sys
+import tempfile
+import time
+
+from romgen import make_rom
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+RECEIVER = os.path.join(HERE, 'build', 'mcast_receiver')
+SENDER = os.path.join(HERE, '..', '..', 'tools', 'ota_mcast_send.py')
+
+
+def main():
+    ap = argparse.ArgumentParser(description='multicast OTA loopback test')
+    ap.add_argument('--receivers', type=int, default=4)
+    ap.add_argument('--loss', type=float, default=0.2,
+                    help='sender side loss, each receiver drops half as much again')
+    ap.add_argument('--size', type=int, default=48 * 1024, help='irom bytes per rom')
+    ap.add_argument('--group', default='239.82.66.77')
+    ap.add_argument('--port', type=int, default=5077)
+    ap.add_argument('--timeout', type=float, default=30)
+    args = ap.parse_args()
+
+    with tempfile.TemporaryDirectory() as tmp:
+        paths = [os.path.join(tmp, 'rom%d.bin' % slot) for slot in range(2)]
+        for slot, path in enumerate(paths):
+            make_rom(path, args.size, seed=slot)
+
+        def receiver(i):
+            slot = i % 2
+            return subprocess.Popen(
+                [RECEIVER, '127.0.0.%d' % (11 + i), args.group, str(args.port), str(slot),
+                 paths[slot], str(args.loss / 2), str(int(args.timeout * 1000))],
+                stdout=subprocess.PIPE, universal_newlines=True)
+
+        receivers = [receiver(i) for i in range(args.receivers - 1)]
+        time.sleep(0.5)
+        sender = subprocess.Popen(
+            [sys.executable, SENDER, paths[0], paths[1], '--group', args.group,
+             '--port', str(args.port), '--interface', '127.0.0.1', '--rate', '2000',
+             '--loss', str(args.loss), '--repair-time', '2', '--session', '0'],
+            stdout=subprocess.PIPE, universal_newlines=True)
+        # the last one only shows up for the repair phase
+        time.sleep(1)
+        receivers.append(receiver(args.receivers - 1))
+
+        failed = 0
+        for rx in receivers:
+            print(rx.communicate()[0], end='')
+            failed += rx.returncode != 0
+        print(sender.communicate()[0], end='')
+        if sender.returncode:
+            print('sender exited with %d' % sender.returncode)
+            failed += 1
+    return 1 if failed else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
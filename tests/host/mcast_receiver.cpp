@@ -0,0 +1,59 @@
+// One device running OTA_multicast_update(), started by mcast_loopback.py.
+//
+//   build/mcast_receiver LOCAL_IP GROUP PORT SLOT ROM LOSS TIMEOUT_MS
+//
+// Boots from the other slot, so SLOT is the one it updates, and drops LOSS
+// of the packets it receives. Fails unless the update ends in a reboot
+// into SLOT holding ROM.
+
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+#include <arpa/inet.h>
+
+#include "rBootOTA.h"
+#include "rBootMcastOTA.h"
+#include "flash_layout.h"
+#include "fakes.h"
+
+int main(int argc, char** argv) {
+    if (argc != 8) {
+        fprintf(stderr, "usage: %s LOCAL_IP GROUP PORT SLOT ROM LOSS TIMEOUT_MS\n", argv[0]);
+        return 2;
+    }
+    fake_local_ip = inet_addr(argv[1]);
+    IPAddress group(inet_addr(argv[2]));
+    uint16_t port = atoi(argv[3]);
+    uint8_t slot = atoi(argv[4]);
+    fake_udp_loss = atof(argv[6]);
+    srand(fake_local_ip);
+
+    static uint8_t rom[FAKE_FLASH_SIZE];
+    FILE* f = fopen(argv[5], "rb");
+    if (!f) {
+        perror(argv[5]);
+        return 2;
+    }
+    size_t rom_size = fread(rom, 1, sizeof(rom), f);
+    fclose(f);
+
+    memset(fake_flash, 0xff, sizeof(fake_flash));
+    rboot_config conf;
+    memset(&conf, 0, sizeof(conf));
+    conf.magic = BOOT_CONFIG_MAGIC;
+    conf.version = BOOT_CONFIG_VERSION;
+    conf.count = 2;
+    conf.current_rom = slot == 0 ? 1 : 0;
+    conf.roms[0] = LAYOUT_ROM0_ADDR;
+    conf.roms[1] = LAYOUT_ROM1_ADDR;
+    rboot_set_config(&conf);
+
+    unsigned long start = millis();
+    OTA_multicast_update(group, port, atoi(argv[7]));
+    unsigned long took = millis() - start;
+
+    bool ok = fake_restarted && rboot_get_current_rom() == slot
+        && memcmp(fake_flash + conf.roms[slot], rom, rom_size) == 0;
+    printf("%s: rom %d in %lu ms, %d sector and %d block erases: %s\n", argv[1], slot, took,
+            fake_sector_erases, fake_block_erases, ok ? "ok" : "FAILED");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,33 @@
+# Test roms for the host tests.
+
+import os
+import random
+import struct
+import subprocess
+import sys
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+ROMINDEX = os.path.join(HERE, '..', '..', 'tools', 'romindex.py')
+
+
+def make_rom(path, irom_size, iram_sizes=(4096,), seed=2, index=True):
+    """an esptool2 -boot2 rom with random contents, indexed like make does"""
+    rng = random.Random(seed)
+    irom = bytes(rng.getrandbits(8) for _ in range(irom_size))
+    rom = struct.pack('<BBBBIII', 0xea, 4, 0, 0, 0x40100000, 0, len(irom)) + irom
+    rom += struct.pack('<BBBBI', 0xe9, len(iram_sizes), 0, 0, 0x40100000)
+    chksum = 0xef
+    address = 0x40100000
+    for size in iram_sizes:
+        iram = bytes(rng.getrandbits(8) for _ in range(size))
+        rom += struct.pack('<II', address, len(iram)) + iram
+        address += size
+        for b in iram:
+            chksum ^= b
+    rom += b'\0' * ((len(rom) | 0x0f) - len(rom)) + bytes([chksum])
+    with open(path, 'wb') as f:
+        f.write(rom)
+    if index:
+        subprocess.check_call([sys.executable, ROMINDEX, path])
+    with open(path, 'rb') as f:
+        return f.read()
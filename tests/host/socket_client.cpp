@@ -0,0 +1,114 @@
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+
+// WiFiClient over host tcp sockets, and the real clock
+
+unsigned long millis() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+void delay(unsigned long ms) {
+    usleep(ms * 1000);
+}
+
+int WiFiClient::connect(IPAddress ip, uint16_t port) {
+    struct sockaddr_in sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sin_family = AF_INET;
+    sa.sin_port = htons(port);
+    sa.sin_addr.s_addr = ip;
+
+    stop();
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) return 0;
+    if (::connect(fd, (struct sockaddr*)&sa, sizeof(sa)) != 0) {
+        stop();
+        return 0;
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    fcntl(fd, F_SETFL, O_NONBLOCK);
+    return 1;
+}
+
+// like the core's, true while there is data left even if the peer is gone
+uint8_t WiFiClient::connected() {
+    if (fd < 0) return 0;
+    char c;
+    ssize_t n = recv(fd, &c, 1, MSG_PEEK);
+    return n > 0 || (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK));
+}
+
+void WiFiClient::stop() {
+    if (fd >= 0) close(fd);
+    fd = -1;
+}
+
+WiFiClient::operator bool() { return fd >= 0; }
+
+int WiFiClient::available() {
+    int n = 0;
+    if (fd < 0 || ioctl(fd, FIONREAD, &n) != 0) return 0;
+    return n;
+}
+
+int WiFiClient::read() {
+    uint8_t c;
+    return read(&c, 1) == 1 ? c : -1;
+}
+
+int WiFiClient::read(uint8_t* buf, size_t size) {
+    if (fd < 0) return -1;
+    ssize_t n = recv(fd, buf, size, 0);
+    return n < 0 ? -1 : n;
+}
+
+// waits up to a second for all of it, like Stream::readBytes()
+size_t WiFiClient::readBytes(uint8_t* buf, size_t size) {
+    size_t got = 0;
+    unsigned long start = millis();
+    while (got < size && fd >= 0 && millis() - start < 1000) {
+        ssize_t n = recv(fd, buf + got, size - got, 0);
+        if (n > 0) {
+            got += n;
+        } else if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+            break;
+        } else {
+            struct pollfd p = { fd, POLLIN, 0 };
+            poll(&p, 1, 10);
+        }
+    }
+    return got;
+}
+
+size_t WiFiClient::write(const uint8_t* buf, size_t size) {
+    size_t sent = 0;
+    while (fd >= 0 && sent < size) {
+        ssize_t n = send(fd, buf + sent, size - sent, MSG_NOSIGNAL);
+        if (n > 0) {
+            sent += n;
+        } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            struct pollfd p = { fd, POLLOUT, 0 };
+            poll(&p, 1, 10);
+        } else {
+            break;
+        }
+    }
+    return sent;
+}
+
+size_t WiFiClient::print(const char* s) {
+    return write((const uint8_t*)s, strlen(s));
+}
@@ -0,0 +1,115 @@
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+#include <WiFiUdp.h>
+
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "fakes.h"
+
+// WiFiUDP over host udp sockets. A device has one socket for both the
+// group and its own address. Here the group socket is bound to the group
+// address, and a second one to WiFi.localIP(), so that several receivers
+// on one host (each with its own 127.x.y.z) get their own unicast replies.
+
+float fake_udp_loss = 0;
+
+static int udp_socket(uint32_t addr, uint16_t port) {
+    struct sockaddr_in sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sin_family = AF_INET;
+    sa.sin_port = htons(port);
+    sa.sin_addr.s_addr = addr;
+
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) return -1;
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (bind(fd, (struct sockaddr*)&sa, sizeof(sa)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+uint8_t WiFiUDP::beginMulticast(IPAddress interfaceAddr, IPAddress multicast, uint16_t port) {
+    stop();
+    group_fd = udp_socket(multicast, port);
+    unicast_fd = udp_socket(interfaceAddr, port);
+    if (group_fd < 0 || unicast_fd < 0) {
+        stop();
+        return 0;
+    }
+    struct ip_mreq mreq;
+    mreq.imr_multiaddr.s_addr = multicast;
+    mreq.imr_interface.s_addr = htonl(INADDR_LOOPBACK);
+    if (setsockopt(group_fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) != 0) {
+        stop();
+        return 0;
+    }
+    return 1;
+}
+
+int WiFiUDP::parsePacket() {
+    struct pollfd fds[2] = { { group_fd, POLLIN, 0 }, { unicast_fd, POLLIN, 0 } };
+    packet_len = packet_pos = 0;
+    // a little wait instead of the busy loop a device would do
+    if (group_fd < 0 || poll(fds, 2, 1) <= 0) {
+        return 0;
+    }
+    int fd = (fds[0].revents & POLLIN) ? group_fd : unicast_fd;
+
+    struct sockaddr_in sa;
+    socklen_t sa_len = sizeof(sa);
+    ssize_t n = recvfrom(fd, packet, sizeof(packet), 0, (struct sockaddr*)&sa, &sa_len);
+    if (n <= 0 || (float)rand() / RAND_MAX < fake_udp_loss) {
+        return 0;
+    }
+    remote_ip = sa.sin_addr.s_addr;
+    remote_port = ntohs(sa.sin_port);
+    packet_len = n;
+    return n;
+}
+
+int WiFiUDP::read(uint8_t* buf, size_t size) {
+    size_t n = packet_len - packet_pos;
+    if (n > size) n = size;
+    memcpy(buf, packet + packet_pos, n);
+    packet_pos += n;
+    return n;
+}
+
+IPAddress WiFiUDP::remoteIP() { return IPAddress(remote_ip); }
+uint16_t WiFiUDP::remotePort() { return remote_port; }
+
+int WiFiUDP::beginPacket(IPAddress ip, uint16_t port) {
+    out_ip = ip;
+    out_port = port;
+    out_len = 0;
+    return 1;
+}
+
+size_t WiFiUDP::write(const uint8_t* buf, size_t size) {
+    if (size > sizeof(out) - out_len) size = sizeof(out) - out_len;
+    memcpy(out + out_len, buf, size);
+    out_len += size;
+    return size;
+}
+
+int WiFiUDP::endPacket() {
+    struct sockaddr_in sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sin_family = AF_INET;
+    sa.sin_port = htons(out_port);
+    sa.sin_addr.s_addr = out_ip;
+    return sendto(unicast_fd, out, out_len, 0, (struct sockaddr*)&sa, sizeof(sa)) == (ssize_t)out_len;
+}
+
+void WiFiUDP::stop() {
+    if (group_fd >= 0) close(group_fd);
+    if (unicast_fd >= 0) close(unicast_fd);
+    group_fd = unicast_fd = -1;
+}
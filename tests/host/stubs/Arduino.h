@@ -0,0 +1,16 @@
+#pragma once
+// just enough of the Arduino core for the OTA code to build on the host,
+// see ../fakes.cpp
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#define ICACHE_RAM_ATTR
+#define ICACHE_FLASH_ATTR
+typedef uint8_t uint8; typedef uint16_t uint16; typedef uint32_t uint32; typedef int32_t int32;
+void yield(); unsigned long millis(); void delay(unsigned long);
+void noInterrupts(); void interrupts();
+#define WDT_FEED()
+struct EspClass { void restart(); };
+extern EspClass ESP;
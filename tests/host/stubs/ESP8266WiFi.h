@@ -0,0 +1,21 @@
+#pragma once
+#include "IPAddress.h"
+#include <stddef.h>
+// a client that "connects" to the canned response in fake_client.cpp, or
+// to a real server with socket_client.cpp
+struct WiFiClient {
+    int fd = -1;
+    int connect(IPAddress ip, uint16_t port);
+    uint8_t connected();
+    void stop();
+    operator bool();
+    int available();
+    int read();
+    int read(uint8_t* buf, size_t size);
+    size_t readBytes(uint8_t* buf, size_t size);
+    size_t write(const uint8_t* buf, size_t size);
+    size_t print(const char* s);
+};
+struct WiFiServer { WiFiServer(uint16_t); void begin(); WiFiClient available(); };
+struct WiFiClass { IPAddress localIP(); };
+extern WiFiClass WiFi;
@@ -0,0 +1,9 @@
+#pragma once
+#include <stdint.h>
+struct IPAddress {
+    uint32_t addr;
+    IPAddress() : addr(0) {}
+    IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : addr(a | b << 8 | c << 16 | (uint32_t)d << 24) {}
+    IPAddress(uint32_t a) : addr(a) {}
+    operator uint32_t() const { return addr; }
+};
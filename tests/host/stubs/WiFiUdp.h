@@ -0,0 +1,26 @@
+#pragma once
+#include "ESP8266WiFi.h"
+// multicast and unicast over host udp sockets, see ../socket_udp.cpp
+class WiFiUDP {
+public:
+    uint8_t beginMulticast(IPAddress interfaceAddr, IPAddress multicast, uint16_t port);
+    int parsePacket();
+    int read(uint8_t* buf, size_t size);
+    IPAddress remoteIP();
+    uint16_t remotePort();
+    int beginPacket(IPAddress ip, uint16_t port);
+    size_t write(const uint8_t* buf, size_t size);
+    int endPacket();
+    void stop();
+    ~WiFiUDP() { stop(); }
+private:
+    int group_fd = -1, unicast_fd = -1;
+    uint8_t packet[1500];
+    int packet_len = 0, packet_pos = 0;
+    uint32_t remote_ip = 0;
+    uint16_t remote_port = 0;
+    uint8_t out[1500];
+    size_t out_len = 0;
+    uint32_t out_ip = 0;
+    uint16_t out_port = 0;
+};
@@ -0,0 +1,13 @@
+#pragma once
+#include <stddef.h>
+// counted, and made to fail on demand, by fakes.cpp
+#ifdef __cplusplus
+extern "C" {
+#endif
+void* host_malloc(size_t size);
+void host_free(void* ptr);
+#ifdef __cplusplus
+}
+#endif
+#define os_malloc host_malloc
+#define os_free host_free
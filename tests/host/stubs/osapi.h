@@ -0,0 +1,13 @@
+#pragma once
+#include <string.h>
+#include <stdio.h>
+#define os_memset memset
+#define os_memcpy memcpy
+#define os_memmove memmove
+static inline char* os_strstr(const char* a, const char* b) { return (char*)strstr(a, b); }
+#define os_printf printf
+#define os_strlen strlen
+#define os_strcmp strcmp
+#define os_strncmp strncmp
+#define IPSTR "%d.%d.%d.%d"
+#define IP2STR(ip) (int)((ip) & 0xff), (int)(((ip) >> 8) & 0xff), (int)(((ip) >> 16) & 0xff), (int)((ip) >> 24)
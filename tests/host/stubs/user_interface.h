@@ -0,0 +1,13 @@
+#pragma once
+#include <stdbool.h>
+#ifdef __cplusplus
+extern "C" {
+#endif
+int spi_flash_read(uint32 addr, uint32* data, uint32 len);
+int spi_flash_write(uint32 addr, uint32* data, uint32 len);
+int spi_flash_erase_sector(uint16 sector);
+bool system_rtc_mem_read(uint8 block, void* data, uint16 len);
+bool system_rtc_mem_write(uint8 block, const void* data, uint16 len);
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,130 @@
+// The config and update paths must not touch the heap once an arena is
+// set, see OTA_set_arena(). Runs them with an os_malloc that always fails.
+
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+
+#include "rBootOTA.h"
+#include "rBootOTA-private.h"
+#include "flash_layout.h"
+#include "fakes.h"
+
+static int failures = 0;
+
+#define CHECK(cond) do { \
+        if (!(cond)) { \
+            printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            failures++; \
+        } \
+    } while (0)
+
+#define ROM_SIZE 0x3000
+
+static uint8_t response[128 + ROM_SIZE];
+static size_t response_len;
+
+static void setup_flash() {
+    memset(fake_flash, 0xff, sizeof(fake_flash));
+
+    rboot_config conf;
+    memset(&conf, 0, sizeof(conf));
+    conf.magic = BOOT_CONFIG_MAGIC;
+    conf.version = BOOT_CONFIG_VERSION;
+    conf.count = 2;
+    conf.roms[0] = LAYOUT_ROM0_ADDR;
+    conf.roms[1] = LAYOUT_ROM1_ADDR;
+    fake_malloc_fails = false;
+    rboot_set_config(&conf);
+
+    // something of the application's behind the config, must survive
+    memset(fake_flash + BOOT_CONFIG_SECTOR * SECTOR_SIZE + 0x800, 0xa5, 16);
+    memset(fake_flash + BOOT_CONFIG_SECTOR * SECTOR_SIZE + 0x800, 0x5a, 8);
+
+    int n = snprintf((char*)response, sizeof(response),
+            "HTTP/1.0 200 OK\r\nContent-Length: %d\r\n\r\n", ROM_SIZE);
+    for (int i = 0; i < ROM_SIZE; i++) {
+        response[n + i] = (uint8_t)(i * 7 + 3);
+    }
+    response_len = n + ROM_SIZE;
+    fake_serve(response, response_len);
+    fake_restarted = false;
+}
+
+static bool app_data_intact() {
+    const uint8_t* p = fake_flash + BOOT_CONFIG_SECTOR * SECTOR_SIZE + 0x800;
+    return p[0] == 0x5a && p[7] == 0x5a && p[8] == 0xa5 && p[15] == 0xa5;
+}
+
+static void test_heap_failure_is_handled() {
+    setup_flash();
+    OTA_set_arena(NULL, 0);
+    fake_malloc_fails = true;
+
+    rboot_config conf = rboot_get_config();
+    conf.current_rom = 1;
+    CHECK(!rboot_set_config(&conf));
+    CHECK(rboot_get_current_rom() == 0);
+
+    OTA_update(IPAddress(192, 168, 42, 42), 8000, "/rom");
+    CHECK(!fake_restarted);
+    CHECK(rboot_get_current_rom() == 0);
+}
+
+static void test_arena_too_small() {
+    static uint32_t small[64];
+    setup_flash();
+    OTA_set_arena(small, sizeof(small));
+    fake_malloc_fails = true;
+    fake_malloc_calls = 0;
+
+    OTA_update(IPAddress(192, 168, 42, 42), 8000, "/rom");
+    CHECK(!fake_restarted);
+    CHECK(rboot_get_current_rom() == 0);
+    CHECK(fake_malloc_calls == 0);
+    OTA_set_arena(NULL, 0);
+}
+
+static void test_no_heap_with_arena() {
+    static uint32_t arena[RBOOT_OTA_ARENA_SIZE / sizeof(uint32_t)];
+    setup_flash();
+    OTA_set_arena(arena, sizeof(arena));
+    fake_malloc_fails = true;
+    fake_malloc_calls = 0;
+
+    rboot_dump_config(NULL);
+
+    rboot_config conf = rboot_get_config();
+    conf.gpio_rom = 1;
+    CHECK(rboot_set_config(&conf));
+    CHECK(rboot_get_config().gpio_rom == 1);
+    CHECK(app_data_intact());
+
+    const uint8_t data[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+    CHECK(ota_config_sector_write(0x800, data, sizeof(data)));
+    CHECK(memcmp(fake_flash + BOOT_CONFIG_SECTOR * SECTOR_SIZE + 0x800, data, 8) == 0);
+    CHECK(rboot_get_config().gpio_rom == 1);
+    memset(fake_flash + BOOT_CONFIG_SECTOR * SECTOR_SIZE + 0x800, 0x5a, 8);
+
+    OTA_update(IPAddress(192, 168, 42, 42), 8000, "/rom");
+    CHECK(fake_restarted);
+    CHECK(rboot_get_current_rom() == 1);
+    CHECK(memcmp(fake_flash + LAYOUT_ROM1_ADDR, response + response_len - ROM_SIZE, ROM_SIZE) == 0);
+    CHECK(fake_flash[LAYOUT_ROM1_ADDR + ROM_SIZE] == 0xff);
+    CHECK(app_data_intact());
+
+    CHECK(fake_malloc_calls == 0);
+}
+
+int main() {
+    test_heap_failure_is_handled();
+    test_arena_too_small();
+    // last, a successful OTA_update() stays in progress until the restart
+    test_no_heap_with_arena();
+
+    if (failures) {
+        printf("test_arena: %d failed\n", failures);
+        return 1;
+    }
+    printf("test_arena: ok\n");
+    return 0;
+}
@@ -0,0 +1,100 @@
+// The erase planner: the command mix ota_erase() issues for slot sized and
+// unaligned ranges, what that costs in the fakes' timing model compared to
+// erasing sector by sector, and that exactly the requested sectors end up
+// erased.
+
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+
+#include "rBootOTA.h"
+#include "rBootOTA-private.h"
+#include "flash_layout.h"
+#include "fakes.h"
+
+static int failures = 0;
+
+#define CHECK(cond) do { \
+        if (!(cond)) { \
+            printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            failures++; \
+        } \
+    } while (0)
+
+static void reset_counts() {
+    fake_sector_erases = fake_block_erases = 0;
+    fake_erase_ms = 0;
+}
+
+// erase len bytes at addr from flash full of zeros, check only the
+// sectors covering them were erased and the commands were as expected
+static void check_erase(const char* name, uint32_t addr, uint32_t len,
+        int sectors, int blocks, uint32_t ms) {
+    uint32_t end = addr + ((len + SECTOR_SIZE - 1) & ~(SECTOR_SIZE - 1));
+    memset(fake_flash, 0, sizeof(fake_flash));
+    reset_counts();
+
+    CHECK(ota_erase(addr, len));
+    CHECK(fake_sector_erases == sectors);
+    CHECK(fake_block_erases == blocks);
+    CHECK(fake_erase_ms == ms);
+    CHECK(fake_flash[addr - 1] == 0);
+    CHECK(end >= FAKE_FLASH_SIZE || fake_flash[end] == 0);
+    bool erased = true;
+    for (uint32_t i = addr; i < end; i++) {
+        erased &= fake_flash[i] == 0xff;
+    }
+    CHECK(erased);
+
+    uint32_t sector_only_ms = (end - addr) / SECTOR_SIZE * FAKE_SECTOR_ERASE_MS;
+    CHECK(fake_erase_ms <= sector_only_ms);
+    printf("%-22s %7u bytes: %3d sectors + %2d blocks, %5u ms, sector by sector %5u ms\n",
+            name, end - addr, sectors, blocks, fake_erase_ms, sector_only_ms);
+}
+
+static void test_erase_size() {
+    CHECK(ota_erase_size(0x80000, 0x100000) == 0x10000);
+    CHECK(ota_erase_size(0x82000, 0x100000) == SECTOR_SIZE);
+    CHECK(ota_erase_size(0x80000, 0x8f000) == SECTOR_SIZE);
+    CHECK(ota_erase_size(0x80000, 0x90000) == 0x10000);
+}
+
+static void test_erase_slot() {
+    rboot_config conf;
+    memset(&conf, 0, sizeof(conf));
+    conf.magic = BOOT_CONFIG_MAGIC;
+    conf.version = BOOT_CONFIG_VERSION;
+    conf.count = 2;
+    conf.roms[0] = LAYOUT_ROM0_ADDR;
+    conf.roms[1] = LAYOUT_ROM1_ADDR;
+    memset(fake_flash, 0xff, sizeof(fake_flash));
+    rboot_set_config(&conf);
+
+    memset(fake_flash + LAYOUT_ROM0_ADDR, 0, LAYOUT_ROM0_SIZE);
+    memset(fake_flash + LAYOUT_ROM1_ADDR, 0, LAYOUT_ROM1_SIZE);
+    CHECK(!OTA_erase_slot(0));
+    CHECK(fake_flash[LAYOUT_ROM0_ADDR] == 0);
+    CHECK(OTA_erase_slot(1));
+    CHECK(fake_flash[LAYOUT_ROM1_ADDR] == 0xff);
+    CHECK(fake_flash[LAYOUT_ROM1_ADDR + LAYOUT_ROM1_SIZE - 1] == 0xff);
+    CHECK(!OTA_erase_slot(2));
+}
+
+int main() {
+    test_erase_size();
+
+    check_erase("512K, block aligned", 0x80000, 0x80000, 0, 8, 1200);
+    check_erase("rom0 slot", LAYOUT_ROM0_ADDR, LAYOUT_ROM0_SIZE, 14, 7, 1680);
+    check_erase("rom1 slot", LAYOUT_ROM1_ADDR, LAYOUT_ROM1_SIZE, 25, 6, 2025);
+    // rom sized, not sector sized: a head and a tail, no whole block
+    check_erase("rom1, 74565 bytes", LAYOUT_ROM1_ADDR, 0x12345, 19, 0, 855);
+    check_erase("one byte", 0x90000, 1, 1, 0, 45);
+
+    test_erase_slot();
+
+    if (failures) {
+        printf("test_erase: %d failed\n", failures);
+        return 1;
+    }
+    printf("test_erase: ok\n");
+    return 0;
+}
@@ -0,0 +1,134 @@
+// Rom urls in the manifest resolve against the manifest's own path, and
+// polls are conditional on the last manifest's validator, see
+// OTA_check_update().
+
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+
+#include "rBootOTA.h"
+#include "flash_layout.h"
+#include "fakes.h"
+
+static int failures = 0;
+
+#define CHECK(cond) do { \
+        if (!(cond)) { \
+            printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            failures++; \
+        } \
+    } while (0)
+
+static char manifest[256];
+static const char not_found[] = "HTTP/1.0 404 Not Found\r\nContent-Length: 0\r\n\r\n";
+
+static void setup_flash() {
+    memset(fake_flash, 0xff, sizeof(fake_flash));
+
+    rboot_config conf;
+    memset(&conf, 0, sizeof(conf));
+    conf.magic = BOOT_CONFIG_MAGIC;
+    conf.version = BOOT_CONFIG_VERSION;
+    conf.count = 2;
+    conf.roms[0] = LAYOUT_ROM0_ADDR;
+    conf.roms[1] = LAYOUT_ROM1_ADDR;
+    rboot_set_config(&conf);
+}
+
+// the rom request OTA_check_update() makes for url1 in a manifest at
+// manifest_url
+static bool rom_request(const char* manifest_url, const char* url1, const char* expect) {
+    // a new version each time, failed ones aren't tried again
+    static int version = 0;
+    char body[64];
+    snprintf(body, sizeof(body), "version=new%d\nsize1=4096\ncrc1=00000000\nurl1=", ++version);
+    snprintf(manifest, sizeof(manifest), "HTTP/1.0 200 OK\r\nContent-Length: %d\r\n\r\n%s%s\n",
+            (int)(strlen(body) + strlen(url1) + 1), body, url1);
+    fake_serve((const uint8_t*)manifest, strlen(manifest));
+    fake_queue((const uint8_t*)not_found, strlen(not_found));
+
+    CHECK(OTA_check_update(IPAddress(192, 168, 42, 42), 8000, manifest_url, "old") == OTA_CHECK_ERROR);
+    char line[128];
+    snprintf(line, sizeof(line), "GET %s HTTP/1.0\r\n", expect);
+    if (strncmp(fake_request, line, strlen(line)) != 0) {
+        printf("%s + %s: expected %s", manifest_url, url1, line);
+        return false;
+    }
+    return true;
+}
+
+// after a manifest naming the running version, the next poll is
+// conditional on the validator it came with
+static bool conditional_request(const char* validator, const char* expect) {
+    const char* body = "version=old\n";
+    snprintf(manifest, sizeof(manifest), "HTTP/1.0 200 OK\r\n%s\r\nContent-Length: %d\r\n\r\n%s",
+            validator, (int)strlen(body), body);
+    fake_serve((const uint8_t*)manifest, strlen(manifest));
+    CHECK(OTA_check_update(IPAddress(192, 168, 42, 42), 8000, "/manifest.txt", "old") == OTA_CHECK_NO_UPDATE);
+
+    static const char not_modified[] = "HTTP/1.0 304 Not Modified\r\n\r\n";
+    fake_serve((const uint8_t*)not_modified, strlen(not_modified));
+    CHECK(OTA_check_update(IPAddress(192, 168, 42, 42), 8000, "/manifest.txt", "old") == OTA_CHECK_NO_UPDATE);
+    if (strstr(fake_request, expect) == NULL) {
+        printf("%s: expected %s in\n%s", validator, expect, fake_request);
+        return false;
+    }
+    return true;
+}
+
+// a version whose rom fails is fetched once, and again only once the
+// manifest names another one
+static void test_failed_version_not_retried() {
+    const char* body = "version=broken\nsize1=4096\ncrc1=00000000\nurl1=rom1.bin\n";
+    snprintf(manifest, sizeof(manifest), "HTTP/1.0 200 OK\r\nContent-Length: %d\r\n\r\n%s",
+            (int)strlen(body), body);
+
+    fake_serve((const uint8_t*)manifest, strlen(manifest));
+    fake_queue((const uint8_t*)not_found, strlen(not_found));
+    CHECK(OTA_check_update(IPAddress(192, 168, 42, 42), 8000, "/manifest.txt", "old") == OTA_CHECK_ERROR);
+    CHECK(strncmp(fake_request, "GET /rom1.bin ", 14) == 0);
+
+    // no validator, so the manifest comes again, but not the rom
+    fake_serve((const uint8_t*)manifest, strlen(manifest));
+    fake_queue((const uint8_t*)not_found, strlen(not_found));
+    CHECK(OTA_check_update(IPAddress(192, 168, 42, 42), 8000, "/manifest.txt", "old") == OTA_CHECK_NO_UPDATE);
+    CHECK(strncmp(fake_request, "GET /manifest.txt ", 18) == 0);
+
+    // with one the next poll is conditional
+    snprintf(manifest, sizeof(manifest), "HTTP/1.0 200 OK\r\nETag: \"b0rk\"\r\n"
+            "Content-Length: %d\r\n\r\n%s", (int)strlen(body), body);
+    fake_serve((const uint8_t*)manifest, strlen(manifest));
+    CHECK(OTA_check_update(IPAddress(192, 168, 42, 42), 8000, "/manifest.txt", "old") == OTA_CHECK_NO_UPDATE);
+    static const char not_modified[] = "HTTP/1.0 304 Not Modified\r\n\r\n";
+    fake_serve((const uint8_t*)not_modified, strlen(not_modified));
+    CHECK(OTA_check_update(IPAddress(192, 168, 42, 42), 8000, "/manifest.txt", "old") == OTA_CHECK_NO_UPDATE);
+    CHECK(strstr(fake_request, "\r\nIf-None-Match: \"b0rk\"\r\n") != NULL);
+
+    // the next release is tried
+    CHECK(rom_request("/manifest.txt", "rom1.bin", "/rom1.bin"));
+    CHECK(!fake_restarted);
+}
+
+int main() {
+    setup_flash();
+
+    CHECK(rom_request("/fw/manifest.txt", "rom1.bin", "/fw/rom1.bin"));
+    CHECK(rom_request("/manifest.txt", "rom1.bin", "/rom1.bin"));
+    CHECK(rom_request("manifest.txt", "rom1.bin", "/rom1.bin"));
+    CHECK(rom_request("/a/b/manifest.txt", "roms/rom1.bin", "/a/b/roms/rom1.bin"));
+    CHECK(rom_request("/fw/manifest.txt", "/other/rom1.bin", "/other/rom1.bin"));
+    CHECK(!fake_restarted);
+
+    test_failed_version_not_retried();
+
+    CHECK(conditional_request("ETag: \"5f2-1a\"", "\r\nIf-None-Match: \"5f2-1a\"\r\n"));
+    CHECK(conditional_request("ETag: W/\"5f2-1a\"", "\r\nIf-None-Match: W/\"5f2-1a\"\r\n"));
+    CHECK(conditional_request("Last-Modified: Mon, 19 Oct 2026 10:00:00 GMT",
+            "\r\nIf-Modified-Since: Mon, 19 Oct 2026 10:00:00 GMT\r\n"));
+
+    if (failures) {
+        printf("test_manifest: %d failed\n", failures);
+        return 1;
+    }
+    printf("test_manifest: ok\n");
+    return 0;
+}
@@ -0,0 +1,104 @@
+// OTA_update_ranged() only takes a 206 with exactly the range it asked
+// for, anything else would be written to the wrong part of the slot.
+
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+
+#include "rBootOTA.h"
+#include "rBootOTA-private.h"
+#include "flash_layout.h"
+#include "fakes.h"
+
+static int failures = 0;
+
+#define CHECK(cond) do { \
+        if (!(cond)) { \
+            printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            failures++; \
+        } \
+    } while (0)
+
+// a rom ota_check_image() takes: no irom, one iram section, checksum
+#define ROM_SIZE 512
+#define SECTION_LEN 464
+
+static uint8_t rom[ROM_SIZE];
+static char probe[128];
+static char region[128 + ROM_SIZE];
+
+static void make_rom() {
+    static const uint8_t head[] = {
+        0xea, 0x04, 0x00, 0x00, 0x00, 0x00, 0x10, 0x40, 0, 0, 0, 0, 0, 0, 0, 0,
+        0xe9, 0x01, 0x00, 0x00, 0x00, 0x00, 0x10, 0x40,
+        0x00, 0x00, 0x10, 0x40, SECTION_LEN & 0xff, SECTION_LEN >> 8, 0x00, 0x00,
+    };
+    uint8_t chksum = 0xef;
+    memset(rom, 0, sizeof(rom));
+    memcpy(rom, head, sizeof(head));
+    for (int i = 0; i < SECTION_LEN; i++) {
+        rom[sizeof(head) + i] = (uint8_t)(i * 7 + 3);
+        chksum ^= (uint8_t)(i * 7 + 3);
+    }
+    rom[ROM_SIZE - 1] = chksum;
+}
+
+static void setup_flash() {
+    memset(fake_flash, 0xff, sizeof(fake_flash));
+
+    rboot_config conf;
+    memset(&conf, 0, sizeof(conf));
+    conf.magic = BOOT_CONFIG_MAGIC;
+    conf.version = BOOT_CONFIG_VERSION;
+    conf.count = 2;
+    conf.roms[0] = LAYOUT_ROM0_ADDR;
+    conf.roms[1] = LAYOUT_ROM1_ADDR;
+    rboot_set_config(&conf);
+    fake_restarted = false;
+}
+
+// the size probe, then the whole rom as the one region with content_range
+static bool update(const char* content_range) {
+    setup_flash();
+    snprintf(probe, sizeof(probe), "HTTP/1.1 206 Partial Content\r\n"
+            "Content-Range: bytes 0-0/%d\r\nContent-Length: 1\r\n\r\n%c", ROM_SIZE, rom[0]);
+    int n = snprintf(region, sizeof(region), "HTTP/1.1 206 Partial Content\r\n"
+            "%sContent-Length: %d\r\n\r\n", content_range, ROM_SIZE);
+    memcpy(region + n, rom, ROM_SIZE);
+    fake_serve((const uint8_t*)probe, strlen(probe));
+    fake_queue((const uint8_t*)region, n + ROM_SIZE);
+
+    OTA_update_ranged(IPAddress(192, 168, 42, 42), 8000, "/rom", 1);
+    return fake_restarted;
+}
+
+static void test_parse() {
+    uint32_t first = 1, last = 1;
+    CHECK(ota_http_range("HTTP/1.1 206\r\nContent-Range: bytes 4096-8191/9000\r\n\r\n", &first, &last));
+    CHECK(first == 4096 && last == 8191);
+    CHECK(!ota_http_range("HTTP/1.1 206\r\n\r\n", &first, &last));
+    CHECK(!ota_http_range("HTTP/1.1 206\r\nContent-Range: bytes */9000\r\n\r\n", &first, &last));
+    CHECK(!ota_http_range("HTTP/1.1 206\r\nContent-Range: bytes 10-/9000\r\n\r\n", &first, &last));
+    CHECK(!ota_http_range("HTTP/1.1 206\r\nContent-Range: bytes 10-5/9000\r\n\r\n", &first, &last));
+    CHECK(!ota_http_range("HTTP/1.1 206\r\nContent-Range: items 0-5/9000\r\n\r\n", &first, &last));
+}
+
+int main() {
+    make_rom();
+    test_parse();
+
+    CHECK(!update(""));
+    CHECK(!update("Content-Range: bytes 1-512/512\r\n"));
+    CHECK(!update("Content-Range: bytes 0-510/512\r\n"));
+    CHECK(!update("Content-Range: bytes 0-511\r\n"));
+    // last, a successful update stays in progress until the restart
+    CHECK(update("Content-Range: bytes 0-511/512\r\n"));
+    CHECK(rboot_get_current_rom() == 1);
+    CHECK(memcmp(fake_flash + LAYOUT_ROM1_ADDR, rom, ROM_SIZE) == 0);
+
+    if (failures) {
+        printf("test_range: %d failed\n", failures);
+        return 1;
+    }
+    printf("test_range: ok\n");
+    return 0;
+}
@@ -0,0 +1,102 @@
+#!/usr/bin/env python3
+#
+# tools/romindex.py, and the index checks in ota_check_image() run on its
+# output through build/check_rom.
+
+import os
+import struct
+import subprocess
+import sys
+import tempfile
+import zlib
+
+from romgen import ROMINDEX, make_rom
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+CHECK_ROM = os.path.join(HERE, 'build', 'check_rom')
+
+INDEX_MAGIC = 0x58444972
+
+failures = 0
+
+
+def check(cond, what):
+    global failures
+    if not cond:
+        print('check failed: %s' % what)
+        failures += 1
+
+
+def passes(path, data=None):
+    if data is not None:
+        with open(path, 'wb') as f:
+            f.write(data)
+    return subprocess.call([CHECK_ROM, path]) == 0
+
+
+def romindex(path):
+    return subprocess.call([sys.executable, ROMINDEX, path], stderr=subprocess.DEVNULL)
+
+
+def main():
+    with tempfile.TemporaryDirectory() as tmp:
+        path = os.path.join(tmp, 'rom.bin')
+        plain = make_rom(path, 0x3000, (0x804, 0x200, 0x10c), index=False)
+        check(passes(path), 'rom without an index passes')
+
+        rom = make_rom(path, 0x3000, (0x804, 0x200, 0x10c))
+        add, = struct.unpack_from('<I', rom, 8)
+        check(add % 16 == 0 and add >= len(plain), 'add points behind the rom')
+        magic, length, digest = struct.unpack_from('<III', rom, add)
+        check(magic == INDEX_MAGIC and length == add, 'index header')
+        check(digest == zlib.crc32(rom[:add]) & 0xffffffff, 'index digest')
+        count = rom[add + 12 + 1]
+        index_len = 12 + 8 + 4 + 12 * count
+        crc, = struct.unpack_from('<I', rom, add + index_len)
+        check(count == 3 and crc == zlib.crc32(rom[add:add + index_len]) & 0xffffffff,
+              'index lists 3 sections and its crc matches')
+        check(len(rom) == add + index_len + 4, 'index is the last thing in the rom')
+        check(passes(path), 'indexed rom passes')
+
+        # running it again replaces the index rather than adding one
+        check(romindex(path) == 0, 'romindex runs again')
+        with open(path, 'rb') as f:
+            check(f.read() == rom, 'rerun gives the same rom')
+
+        # the walk skips section headers, the index doesn't: a load address
+        # changed in the rom is caught only through the index
+        first_section = 16 + 0x3000 + 8
+        bad = bytearray(rom)
+        bad[first_section] ^= 0x04
+        check(not passes(path, bad), 'section header not matching the index is rejected')
+
+        # a damaged index is ignored and the rom walked as before
+        bad = bytearray(rom)
+        bad[add + 24] ^= 0x01
+        check(passes(path, bad), 'rom with a damaged index falls back to the walk')
+        bad[first_section + 8] ^= 0x01
+        check(not passes(path, bad), 'the walk still catches bad data')
+
+        # the digest covers the irom too, which the checksum doesn't
+        bad = bytearray(rom)
+        bad[100] ^= 0x01
+        check(not passes(path, bad), 'irom damage is caught by the digest')
+        check(passes(path, bytearray(plain[:100]) + bytes([plain[100] ^ 1]) + plain[101:]),
+              'without an index irom damage goes unnoticed, as in rboot')
+
+        # the index has to be where add says, and nothing else is stripped
+        bad = bytearray(plain)
+        struct.pack_into('<I', bad, 8, 0x1230)
+        with open(path, 'wb') as f:
+            f.write(bad)
+        check(romindex(path) != 0, 'romindex refuses an add field that is not an index')
+
+    if failures:
+        print('test_romindex: %d failed' % failures)
+        return 1
+    print('test_romindex: ok')
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,39 @@
+#!/usr/bin/env python3
+#
+# Write the update manifest for OTA_check_update(), run by make.
+#
+#   tools/mkmanifest.py VERSION firmware/rom0.bin firmware/rom1.bin > manifest.txt
+#
+# One key=value per line: the version, then the size, crc32 and url of
+# each rom. The urls are the bare rom file names, which the device resolves
+# against the manifest's own path, so serve the manifest from the same
+# directory as the roms. Give --url-prefix for roms kept elsewhere, a prefix
+# starting with / makes the urls absolute.
+
+import argparse
+import os
+import zlib
+
+
+def main():
+    ap = argparse.ArgumentParser(description='update manifest for OTA_check_update()')
+    ap.add_argument('version')
+    ap.add_argument('roms', nargs='+', help='rom0.bin, rom1.bin, ... in slot order')
+    ap.add_argument('--url-prefix', default='',
+                    help='prepended to the rom file names')
+    args = ap.parse_args()
+
+    if any(c.isspace() for c in args.version):
+        raise SystemExit('version must not contain whitespace')
+
+    print('version=%s' % args.version)
+    for slot, path in enumerate(args.roms):
+        with open(path, 'rb') as f:
+            data = f.read()
+        print('size%d=%d' % (slot, len(data)))
+        print('crc%d=%08x' % (slot, zlib.crc32(data) & 0xffffffff))
+        print('url%d=%s%s' % (slot, args.url_prefix, os.path.basename(path)))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,156 @@
+#!/usr/bin/env python3
+#
+# Multicast sender for OTA_multicast_update(), see rBootMcastOTA.h for the
+# wire format.
+#
+#   tools/ota_mcast_send.py firmware/rom0.bin firmware/rom1.bin
+#
+# Both images are sent, each device only keeps the one linked for its
+# upgrade slot. After every round the sender listens for unicast NAKs and
+# answers them with the missing blocks.
+
+import argparse
+import random
+import select
+import socket
+import struct
+import time
+import zlib
+
+MAGIC = 0x434d4272
+DATA, PARITY, END, NAK = 1, 2, 3, 4
+HEADER = struct.Struct('<IBBHIIIHBB')
+
+
+class Image:
+    def __init__(self, slot, path, session, block_size, group_size):
+        with open(path, 'rb') as f:
+            self.data = f.read()
+        if len(self.data) % 4:
+            raise SystemExit('%s: size is not a multiple of 4' % path)
+        self.slot = slot
+        self.session = session
+        self.block_size = block_size
+        self.group_size = group_size
+        self.crc = zlib.crc32(self.data) & 0xffffffff
+        self.blocks = (len(self.data) + block_size - 1) // block_size
+
+    def header(self, kind, index, count=0):
+        return HEADER.pack(MAGIC, kind, self.slot, index, self.session,
+                           len(self.data), self.crc, self.block_size,
+                           self.group_size, count)
+
+    def block(self, index):
+        return self.data[index * self.block_size:(index + 1) * self.block_size]
+
+    def parity(self, group):
+        out = bytearray(self.block_size)
+        first = group * self.group_size
+        for index in range(first, min(first + self.group_size, self.blocks)):
+            for i, b in enumerate(self.block(index)):
+                out[i] ^= b
+        return bytes(out)
+
+    def packets(self):
+        for index in range(self.blocks):
+            yield self.header(DATA, index) + self.block(index)
+            if (index + 1) % self.group_size == 0 or index + 1 == self.blocks:
+                group = index // self.group_size
+                yield self.header(PARITY, group) + self.parity(group)
+
+
+def interleave(*generators):
+    generators = list(generators)
+    while generators:
+        for gen in list(generators):
+            try:
+                yield next(gen)
+            except StopIteration:
+                generators.remove(gen)
+
+
+def main():
+    ap = argparse.ArgumentParser(description='multicast rom sender for OTA_multicast_update()')
+    ap.add_argument('rom0')
+    ap.add_argument('rom1')
+    ap.add_argument('--group', default='239.82.66.77', help='multicast group')
+    ap.add_argument('--port', type=int, default=5077)
+    ap.add_argument('--ttl', type=int, default=1)
+    ap.add_argument('--interface', help='local address to send from')
+    ap.add_argument('--block-size', type=int, default=1024)
+    ap.add_argument('--group-size', type=int, default=8,
+                    help='data blocks per parity block')
+    ap.add_argument('--rate', type=float, default=200,
+                    help='packets per second')
+    ap.add_argument('--rounds', type=int, default=1,
+                    help='times to send the whole image pair')
+    ap.add_argument('--repair-time', type=float, default=10,
+                    help='seconds to answer NAKs after the last round')
+    ap.add_argument('--loss', type=float, default=0,
+                    help='drop this fraction of multicast packets, for testing')
+    ap.add_argument('--session', type=lambda s: int(s, 0),
+                    help='session id, random by default')
+    args = ap.parse_args()
+
+    if args.block_size % 4 or not 512 <= args.block_size <= 1024:
+        raise SystemExit('block size must be a multiple of 4 in 512..1024')
+
+    session = args.session
+    if session is None:
+        session = random.randrange(1 << 32)
+    images = [Image(0, args.rom0, session, args.block_size, args.group_size),
+              Image(1, args.rom1, session, args.block_size, args.group_size)]
+
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM, socket.IPPROTO_UDP)
+    sock.setsockopt(socket.IPPROTO_IP, socket.IP_MULTICAST_TTL, args.ttl)
+    if args.interface:
+        sock.setsockopt(socket.IPPROTO_IP, socket.IP_MULTICAST_IF,
+                        socket.inet_aton(args.interface))
+    sock.bind(('', 0))
+    dest = (args.group, args.port)
+    delay = 1.0 / args.rate
+    dropped = sent = 0
+
+    for round_no in range(args.rounds):
+        for pkt in interleave(*(img.packets() for img in images)):
+            sent += 1
+            if random.random() < args.loss:
+                dropped += 1
+            else:
+                sock.sendto(pkt, dest)
+            time.sleep(delay)
+        for img in images:
+            sock.sendto(img.header(END, 0), dest)
+        print('round %d: %d packets, %d dropped' % (round_no + 1, sent, dropped))
+
+    # repair phase, keep announcing END so late receivers start NAKing
+    repaired = 0
+    deadline = time.time() + args.repair_time
+    next_end = 0
+    while time.time() < deadline:
+        if time.time() >= next_end:
+            for img in images:
+                sock.sendto(img.header(END, 0), dest)
+            next_end = time.time() + 1
+        ready, _, _ = select.select([sock], [], [], 0.1)
+        if not ready:
+            continue
+        pkt, addr = sock.recvfrom(2048)
+        if len(pkt) < HEADER.size:
+            continue
+        magic, kind, slot, _, sess, _, _, _, _, count = HEADER.unpack_from(pkt)
+        if magic != MAGIC or kind != NAK or sess != session or slot > 1:
+            continue
+        img = images[slot]
+        wanted = struct.unpack_from('<%dH' % count, pkt, HEADER.size)
+        for index in wanted:
+            if index < img.blocks:
+                sock.sendto(img.header(DATA, index) + img.block(index), addr)
+                repaired += 1
+        deadline = time.time() + args.repair_time
+
+    print('done, %d blocks repaired by unicast' % repaired)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,91 @@
+#!/usr/bin/env python3
+#
+# Push roms to devices running OTA_push_loop(), many at a time.
+#
+#   tools/ota_push.py firmware 192.168.42.10 192.168.42.11 ...
+#
+# Each device is asked which slot it wants, sent the matching rom, and the
+# crc32 it reports back is compared with the file. Prints per device and
+# overall times, so it doubles as a line throughput benchmark.
+
+import argparse
+import concurrent.futures
+import http.client
+import os
+import sys
+import time
+import zlib
+
+
+def push(host, args, roms):
+    started = time.time()
+    conn = http.client.HTTPConnection(host, args.port, timeout=args.timeout)
+    conn.request('GET', args.path)
+    resp = conn.getresponse()
+    body = resp.read().decode(errors='replace')
+    conn.close()
+    if resp.status != 200:
+        raise RuntimeError('slot query: %d %s' % (resp.status, body.strip()))
+    slot = int(body.strip())
+    data, crc = roms[slot]
+
+    conn = http.client.HTTPConnection(host, args.port, timeout=args.timeout)
+    conn.request('POST', args.path, body=data, headers={
+        'Content-Type': 'application/octet-stream',
+        'X-Rom-Slot': str(slot),
+    })
+    resp = conn.getresponse()
+    body = resp.read().decode(errors='replace')
+    conn.close()
+    if resp.status != 200:
+        raise RuntimeError('%d %s' % (resp.status, body.strip()))
+
+    fields = dict(line.split('=', 1) for line in body.split() if '=' in line)
+    if int(fields.get('crc32', '0'), 16) != crc:
+        raise RuntimeError('crc32 mismatch, device has %s, rom is %08x'
+                           % (fields.get('crc32'), crc))
+    return slot, len(data), time.time() - started
+
+
+def main():
+    ap = argparse.ArgumentParser(description='push roms to OTA_push_loop() devices')
+    ap.add_argument('firmware', help='directory with rom0.bin and rom1.bin')
+    ap.add_argument('hosts', nargs='+')
+    ap.add_argument('--port', type=int, default=8266)
+    ap.add_argument('--path', default='/update')
+    ap.add_argument('--jobs', type=int, default=16,
+                    help='devices to push to at the same time')
+    ap.add_argument('--timeout', type=float, default=90)
+    args = ap.parse_args()
+
+    roms = []
+    for slot in (0, 1):
+        with open(os.path.join(args.firmware, 'rom%d.bin' % slot), 'rb') as f:
+            data = f.read()
+        roms.append((data, zlib.crc32(data) & 0xffffffff))
+
+    started = time.time()
+    total = failed = 0
+    with concurrent.futures.ThreadPoolExecutor(max_workers=args.jobs) as pool:
+        jobs = {pool.submit(push, host, args, roms): host for host in args.hosts}
+        for job in concurrent.futures.as_completed(jobs):
+            host = jobs[job]
+            try:
+                slot, size, took = job.result()
+            except Exception as e:
+                failed += 1
+                print('%s: FAILED: %s' % (host, e))
+                continue
+            total += size
+            print('%s: rom%d, %d bytes in %.1fs (%.1f KB/s)'
+                  % (host, slot, size, took, size / took / 1024))
+
+    took = time.time() - started
+    done = len(args.hosts) - failed
+    print('%d of %d devices in %.1fs, %.1f KB/s total, %.1f devices/min'
+          % (done, len(args.hosts), took, total / took / 1024, done * 60 / took))
+    sys.exit(1 if failed else 0)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,108 @@
+#!/usr/bin/env python3
+#
+# Append a section index to an esptool2 -boot2 rom, run by make after
+# esptool2.
+#
+#   tools/romindex.py firmware/rom0.bin
+#
+# The index (rom_index in rboot/rboot-private.h) lists where each iram
+# section's data is in the rom, its load address and length, the rom's xor
+# checksum and a crc32 digest of the whole rom. Its offset goes into the
+# otherwise unused add field of the first header, so rboot can fetch it in
+# one read. Older rboots ignore both. Running it again replaces the index.
+
+import argparse
+import struct
+import zlib
+
+ROM_MAGIC = 0xe9
+ROM_MAGIC_NEW1 = 0xea
+ROM_MAGIC_NEW2 = 0x04
+CHKSUM_INIT = 0xef
+
+INDEX_MAGIC = 0x58444972  # "rIDX"
+MAX_SECTIONS = 16
+
+HEADER_NEW = struct.Struct('<BBBBIII')  # magic, count, flags1, flags2, entry, add, len
+HEADER = struct.Struct('<BBBBI')
+SECTION = struct.Struct('<II')
+INDEX_HEAD = struct.Struct('<III')      # magic, length, digest
+
+
+def crc32(data):
+    return zlib.crc32(data) & 0xffffffff
+
+
+def strip_index(rom):
+    """rom without an index, or unchanged if it has none"""
+    magic, count, _, _, _, add, _ = HEADER_NEW.unpack_from(rom)
+    if add == 0:
+        return rom
+    if add + INDEX_HEAD.size + HEADER.size > len(rom):
+        raise SystemExit('header add field is 0x%x, not an index' % add)
+    index_magic, length, _ = INDEX_HEAD.unpack_from(rom, add)
+    if index_magic != INDEX_MAGIC or length != add:
+        raise SystemExit('header add field is 0x%x, not an index' % add)
+    rom = bytearray(rom[:add])
+    struct.pack_into('<I', rom, 8, 0)
+    return bytes(rom)
+
+
+def walk(rom):
+    """the rom header, section list and xor checksum, as check_image() sees them"""
+    magic, count, _, _, _, _, irom_len = HEADER_NEW.unpack_from(rom)
+    if magic != ROM_MAGIC_NEW1 or count != ROM_MAGIC_NEW2:
+        raise SystemExit('not an esptool2 -boot2 rom')
+    pos = HEADER_NEW.size + irom_len
+    header = rom[pos:pos + HEADER.size]
+    magic, count, _, _, _ = HEADER.unpack(header)
+    if magic != ROM_MAGIC:
+        raise SystemExit('bad iram rom header')
+    if not 0 < count <= MAX_SECTIONS:
+        raise SystemExit('%d sections, the index takes 1 to %d' % (count, MAX_SECTIONS))
+    pos += HEADER.size
+
+    sections = []
+    chksum = CHKSUM_INIT
+    for _ in range(count):
+        address, length = SECTION.unpack_from(rom, pos)
+        pos += SECTION.size
+        data = rom[pos:pos + length]
+        if len(data) != length:
+            raise SystemExit('section at 0x%x runs past the end' % pos)
+        sections.append((pos, address, length))
+        for b in data:
+            chksum ^= b
+        pos += length
+
+    pos |= 0x0f
+    if pos >= len(rom) or rom[pos] != chksum:
+        raise SystemExit('bad rom checksum')
+    return header, sections, chksum
+
+
+def main():
+    ap = argparse.ArgumentParser(description='append a section index to an rboot rom')
+    ap.add_argument('rom')
+    args = ap.parse_args()
+
+    with open(args.rom, 'rb') as f:
+        rom = strip_index(f.read())
+    header, sections, chksum = walk(rom)
+
+    # the index starts 16 byte aligned, where esptool2's padding ends
+    rom = bytearray(rom + b'\0' * (-len(rom) % 16))
+    struct.pack_into('<I', rom, 8, len(rom))
+
+    index = INDEX_HEAD.pack(INDEX_MAGIC, len(rom), crc32(rom)) + header
+    index += struct.pack('<I', chksum)
+    for offset, address, length in sections:
+        index += struct.pack('<III', offset, address, length)
+    index += struct.pack('<I', crc32(index))
+
+    with open(args.rom, 'wb') as f:
+        f.write(rom + index)
+
+
+if __name__ == '__main__':
+    main()